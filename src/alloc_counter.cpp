@@ -0,0 +1,76 @@
+#include "alloc_counter.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+using namespace std;
+
+// The replacements live in their own translation unit so they are never
+// inlined into the code that calls new and delete.
+
+namespace {
+
+atomic<long> num_allocations(0);
+
+void *allocate(size_t size) {
+  num_allocations.fetch_add(1, memory_order_relaxed);
+  return malloc(size ? size : 1);
+}
+
+}  // namespace
+
+long numAllocations() {
+  return num_allocations.load(memory_order_relaxed);
+}
+
+void *operator new(size_t size) {
+  void *p = allocate(size);
+  if (!p) {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](size_t size) {
+  void *p = allocate(size);
+  if (!p) {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, const nothrow_t &) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p, const nothrow_t &) noexcept {
+  free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  free(p);
+}
+#endif
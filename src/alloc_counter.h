@@ -0,0 +1,9 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+// Heap allocations of the process so far. Linking alloc_counter.cpp
+// replaces every form of the global operator new and delete with
+// malloc/free that counts the allocations.
+long numAllocations();
+
+#endif /* ALLOC_COUNTER_H */
@@ -0,0 +1,564 @@
+// Microbenchmarks for the geometry and spline kernels and the per-frame
+// planning path. Besides ns/op every benchmark reports the heap
+// allocations per operation (allocs/op) and its throughput.
+//
+// path_planning_bench [benchmark flags]
+//
+// PATH_PLANNING_MAP overrides the map file, PATH_PLANNING_LOG replays the
+// telemetry frames of a recorded log in the frame benchmarks instead of
+// frames from the headless simulator.
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "alloc_counter.h"
+#include "control_message.h"
+#include "path_planner.h"
+#include "road_map.h"
+#include "simulator.h"
+#include "spline.h"
+#include "telemetry.h"
+#include "telemetry_log.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+// same map and setup as the server
+const double kMaxS = 6945.554;
+// frames generated when no log is given
+const int kSimulatedFrames = 2000;
+// random samples the geometry benchmarks cycle through
+const int kSamples = 1024;
+
+// Counts the allocations between construction and report()
+class AllocationCounter {
+ public:
+  AllocationCounter() : start_(numAllocations()) {}
+
+  void report(benchmark::State &state) const {
+    state.counters["allocs/op"] = benchmark::Counter(
+        (double)(numAllocations() - start_),
+        benchmark::Counter::kAvgIterations);
+  }
+
+ private:
+  long start_;
+};
+
+const RoadMap *loadRoadMap() {
+  static RoadMap road_map;
+  static bool loaded = false;
+  static bool ok = false;
+  if (!loaded) {
+    const char *env = getenv("PATH_PLANNING_MAP");
+    string map_file_ = env ? env : "../data/highway_map.csv";
+    ok = road_map.load(map_file_, kMaxS);
+    if (ok) {
+      road_map.resample(0.5);
+    }
+    loaded = true;
+  }
+  return ok ? &road_map : NULL;
+}
+
+// Telemetry messages for the frame benchmarks, from the log if one is
+// given or else from a run of the headless simulator against the planner
+const vector<string> *loadFrames() {
+  static vector<string> frames;
+  if (!frames.empty()) {
+    return &frames;
+  }
+  const char *log_file = getenv("PATH_PLANNING_LOG");
+  if (log_file) {
+    TelemetryLogReader log;
+    if (!log.open(log_file)) {
+      return NULL;
+    }
+    for (size_t i = 0; i < log.size(); ++i) {
+      LogRecord record = log.record(i);
+      if (record.type == kLogTelemetry) {
+        frames.push_back(string(record.data, record.length));
+      }
+    }
+  } else {
+    const RoadMap *road_map = loadRoadMap();
+    if (!road_map) {
+      return NULL;
+    }
+    Simulator sim(*road_map, SimulatorConfig());
+    ThreadPool pool;
+    PathPlanner planner(*road_map, pool);
+    Telemetry *telemetry = new Telemetry;
+    ControlMessage control;
+    string message;
+    for (int i = 0; i < kSimulatedFrames; ++i) {
+      sim.telemetry(message);
+      frames.push_back(message);
+      parseTelemetry(message.data(), message.size(), *telemetry);
+      planner.plan(*telemetry, sim.stats().time, control);
+      sim.control(control.data(), control.length());
+    }
+    delete telemetry;
+  }
+  return frames.empty() ? NULL : &frames;
+}
+
+// points on the road, spread over the whole loop and all lanes
+void roadSamples(const RoadMap &road_map, vector<double> &s,
+                 vector<double> &d, vector<double> &x, vector<double> &y) {
+  mt19937 rng(1);
+  uniform_real_distribution<double> s_dist(0.0, kMaxS);
+  uniform_real_distribution<double> d_dist(0.0, 12.0);
+  s.resize(kSamples);
+  d.resize(kSamples);
+  x.resize(kSamples);
+  y.resize(kSamples);
+  for (int i = 0; i < kSamples; ++i) {
+    s[i] = s_dist(rng);
+    d[i] = d_dist(rng);
+    road_map.getXY(s[i], d[i], x[i], y[i]);
+  }
+}
+
+void BM_GetFrenet(benchmark::State &state) {
+  const RoadMap *road_map = loadRoadMap();
+  if (!road_map) {
+    state.SkipWithError("failed to load the map");
+    return;
+  }
+  vector<double> s, d, x, y;
+  roadSamples(*road_map, s, d, x, y);
+  int i = 0;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    double fs, fd;
+    road_map->getFrenet(x[i], y[i], fs, fd);
+    benchmark::DoNotOptimize(fs);
+    benchmark::DoNotOptimize(fd);
+    i = (i + 1) % kSamples;
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetFrenet);
+
+void BM_GetXY(benchmark::State &state) {
+  const RoadMap *road_map = loadRoadMap();
+  if (!road_map) {
+    state.SkipWithError("failed to load the map");
+    return;
+  }
+  vector<double> s, d, x, y;
+  roadSamples(*road_map, s, d, x, y);
+  int i = 0;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    double px, py;
+    road_map->getXY(s[i], d[i], px, py);
+    benchmark::DoNotOptimize(px);
+    benchmark::DoNotOptimize(py);
+    i = (i + 1) % kSamples;
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetXY);
+
+// a path of n points 0.5 m apart, the way the planner converts its paths
+void BM_GetXYPath(benchmark::State &state) {
+  const RoadMap *road_map = loadRoadMap();
+  if (!road_map) {
+    state.SkipWithError("failed to load the map");
+    return;
+  }
+  int n = state.range(0);
+  vector<double> s(n), d(n, 6.0), x(n), y(n);
+  for (int i = 0; i < n; ++i) {
+    s[i] = 1000.0 + 0.5 * i;
+  }
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    road_map->getXY(&s[0], &d[0], &x[0], &y[0], n);
+    benchmark::DoNotOptimize(&x[0]);
+    benchmark::DoNotOptimize(&y[0]);
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_GetXYPath)->Arg(50);
+
+void BM_ClosestWaypoint(benchmark::State &state) {
+  const RoadMap *road_map = loadRoadMap();
+  if (!road_map) {
+    state.SkipWithError("failed to load the map");
+    return;
+  }
+  vector<double> s, d, x, y;
+  roadSamples(*road_map, s, d, x, y);
+  int i = 0;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(road_map->ClosestWaypoint(x[i], y[i]));
+    i = (i + 1) % kSamples;
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ClosestWaypoint);
+
+// knots like the planner's: increasing x with a gentle curve
+void splineKnots(int n, vector<double> &x, vector<double> &y) {
+  x.resize(n);
+  y.resize(n);
+  for (int i = 0; i < n; ++i) {
+    x[i] = 30.0 * i;
+    y[i] = 4.0 * sin(0.1 * i);
+  }
+}
+
+void BM_SplineSetPoints(benchmark::State &state) {
+  vector<double> x, y;
+  splineKnots(state.range(0), x, y);
+  tk::spline s;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    s.set_points(x, y);
+    benchmark::ClobberMemory();
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SplineSetPoints)->Arg(5)->Arg(50)->Arg(500);
+
+void BM_StaticSplineSetPoints(benchmark::State &state) {
+  vector<double> x, y;
+  splineKnots(5, x, y);
+  tk::static_spline<8> s;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    s.set_points(&x[0], &y[0], 5);
+    benchmark::ClobberMemory();
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations() * 5);
+}
+BENCHMARK(BM_StaticSplineSetPoints);
+
+void BM_SplineEval(benchmark::State &state) {
+  vector<double> x, y;
+  splineKnots(state.range(0), x, y);
+  tk::spline s;
+  s.set_points(x, y);
+  mt19937 rng(1);
+  uniform_real_distribution<double> dist(x.front(), x.back());
+  vector<double> xs(kSamples);
+  for (int i = 0; i < kSamples; ++i) {
+    xs[i] = dist(rng);
+  }
+  int i = 0;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(s(xs[i]));
+    i = (i + 1) % kSamples;
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SplineEval)->Arg(5)->Arg(50)->Arg(500);
+
+// The band matrix solver tk::spline used before the tridiagonal solve,
+// kept as the baseline for the solver benchmarks.
+namespace tk {
+
+// band matrix solver
+class band_matrix
+{
+private:
+    std::vector< std::vector<double> > m_upper;  // upper band
+    std::vector< std::vector<double> > m_lower;  // lower band
+public:
+    band_matrix() {};                             // constructor
+    band_matrix(int dim, int n_u, int n_l);       // constructor
+    ~band_matrix() {};                            // destructor
+    void resize(int dim, int n_u, int n_l);      // init with dim,n_u,n_l
+    int dim() const;                             // matrix dimension
+    int num_upper() const
+    {
+        return m_upper.size()-1;
+    }
+    int num_lower() const
+    {
+        return m_lower.size()-1;
+    }
+    // access operator
+    double & operator () (int i, int j);            // write
+    double   operator () (int i, int j) const;      // read
+    // we can store an additional diogonal (in m_lower)
+    double& saved_diag(int i);
+    double  saved_diag(int i) const;
+    void lu_decompose();
+    std::vector<double> r_solve(const std::vector<double>& b) const;
+    std::vector<double> l_solve(const std::vector<double>& b) const;
+    std::vector<double> lu_solve(const std::vector<double>& b,
+                                 bool is_lu_decomposed=false);
+
+};
+
+band_matrix::band_matrix(int dim, int n_u, int n_l)
+{
+    resize(dim, n_u, n_l);
+}
+void band_matrix::resize(int dim, int n_u, int n_l)
+{
+    assert(dim>0);
+    assert(n_u>=0);
+    assert(n_l>=0);
+    m_upper.resize(n_u+1);
+    m_lower.resize(n_l+1);
+    for(size_t i=0; i<m_upper.size(); i++) {
+        m_upper[i].resize(dim);
+    }
+    for(size_t i=0; i<m_lower.size(); i++) {
+        m_lower[i].resize(dim);
+    }
+}
+int band_matrix::dim() const
+{
+    if(m_upper.size()>0) {
+        return m_upper[0].size();
+    } else {
+        return 0;
+    }
+}
+
+
+// defines the new operator (), so that we can access the elements
+// by A(i,j), index going from i=0,...,dim()-1
+double & band_matrix::operator () (int i, int j)
+{
+    int k=j-i;       // what band is the entry
+    assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
+    assert( (-num_lower()<=k) && (k<=num_upper()) );
+    // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
+    if(k>=0)   return m_upper[k][i];
+    else	    return m_lower[-k][i];
+}
+double band_matrix::operator () (int i, int j) const
+{
+    int k=j-i;       // what band is the entry
+    assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
+    assert( (-num_lower()<=k) && (k<=num_upper()) );
+    // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
+    if(k>=0)   return m_upper[k][i];
+    else	    return m_lower[-k][i];
+}
+// second diag (used in LU decomposition), saved in m_lower
+double band_matrix::saved_diag(int i) const
+{
+    assert( (i>=0) && (i<dim()) );
+    return m_lower[0][i];
+}
+double & band_matrix::saved_diag(int i)
+{
+    assert( (i>=0) && (i<dim()) );
+    return m_lower[0][i];
+}
+
+// LR-Decomposition of a band matrix
+void band_matrix::lu_decompose()
+{
+    int  i_max,j_max;
+    int  j_min;
+    double x;
+
+    // preconditioning
+    // normalize column i so that a_ii=1
+    for(int i=0; i<this->dim(); i++) {
+        assert(this->operator()(i,i)!=0.0);
+        this->saved_diag(i)=1.0/this->operator()(i,i);
+        j_min=std::max(0,i-this->num_lower());
+        j_max=std::min(this->dim()-1,i+this->num_upper());
+        for(int j=j_min; j<=j_max; j++) {
+            this->operator()(i,j) *= this->saved_diag(i);
+        }
+        this->operator()(i,i)=1.0;          // prevents rounding errors
+    }
+
+    // Gauss LR-Decomposition
+    for(int k=0; k<this->dim(); k++) {
+        i_max=std::min(this->dim()-1,k+this->num_lower());  // num_lower not a mistake!
+        for(int i=k+1; i<=i_max; i++) {
+            assert(this->operator()(k,k)!=0.0);
+            x=-this->operator()(i,k)/this->operator()(k,k);
+            this->operator()(i,k)=-x;                         // assembly part of L
+            j_max=std::min(this->dim()-1,k+this->num_upper());
+            for(int j=k+1; j<=j_max; j++) {
+                // assembly part of R
+                this->operator()(i,j)=this->operator()(i,j)+x*this->operator()(k,j);
+            }
+        }
+    }
+}
+// solves Ly=b
+std::vector<double> band_matrix::l_solve(const std::vector<double>& b) const
+{
+    assert( this->dim()==(int)b.size() );
+    std::vector<double> x(this->dim());
+    int j_start;
+    double sum;
+    for(int i=0; i<this->dim(); i++) {
+        sum=0;
+        j_start=std::max(0,i-this->num_lower());
+        for(int j=j_start; j<i; j++) sum += this->operator()(i,j)*x[j];
+        x[i]=(b[i]*this->saved_diag(i)) - sum;
+    }
+    return x;
+}
+// solves Rx=y
+std::vector<double> band_matrix::r_solve(const std::vector<double>& b) const
+{
+    assert( this->dim()==(int)b.size() );
+    std::vector<double> x(this->dim());
+    int j_stop;
+    double sum;
+    for(int i=this->dim()-1; i>=0; i--) {
+        sum=0;
+        j_stop=std::min(this->dim()-1,i+this->num_upper());
+        for(int j=i+1; j<=j_stop; j++) sum += this->operator()(i,j)*x[j];
+        x[i]=( b[i] - sum ) / this->operator()(i,i);
+    }
+    return x;
+}
+
+std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
+        bool is_lu_decomposed)
+{
+    assert( this->dim()==(int)b.size() );
+    std::vector<double>  x,y;
+    if(is_lu_decomposed==false) {
+        this->lu_decompose();
+    }
+    y=this->l_solve(b);
+    x=this->r_solve(y);
+    return x;
+}
+
+}  // namespace tk
+
+// diagonally dominant tridiagonal system as set up for a cubic spline
+void fillBandMatrix(tk::band_matrix &m, vector<double> &b) {
+  int n = m.dim();
+  b.resize(n);
+  for (int i = 0; i < n; ++i) {
+    m(i, i) = 4.0;
+    if (i > 0) {
+      m(i, i - 1) = 1.0;
+    }
+    if (i + 1 < n) {
+      m(i, i + 1) = 1.0;
+    }
+    b[i] = sin(0.1 * i);
+  }
+}
+
+// decomposition and solve, the matrix is refilled from a copy each time
+void BM_BandMatrixLuSolve(benchmark::State &state) {
+  int n = state.range(0);
+  tk::band_matrix proto(n, 1, 1);
+  vector<double> b;
+  fillBandMatrix(proto, b);
+  tk::band_matrix m = proto;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    m = proto;
+    benchmark::DoNotOptimize(m.lu_solve(b));
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_BandMatrixLuSolve)->Arg(5)->Arg(50)->Arg(500);
+
+// solve only, against a matrix decomposed once
+void BM_BandMatrixLuSolveDecomposed(benchmark::State &state) {
+  int n = state.range(0);
+  tk::band_matrix m(n, 1, 1);
+  vector<double> b;
+  fillBandMatrix(m, b);
+  m.lu_decompose();
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(m.lu_solve(b, true));
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_BandMatrixLuSolveDecomposed)->Arg(5)->Arg(50)->Arg(500);
+
+void BM_ParseTelemetry(benchmark::State &state) {
+  const vector<string> *frames = loadFrames();
+  if (!frames) {
+    state.SkipWithError("no telemetry frames");
+    return;
+  }
+  Telemetry *telemetry = new Telemetry;
+  size_t i = 0;
+  int64_t bytes = 0;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    const string &frame = (*frames)[i];
+    benchmark::DoNotOptimize(
+        parseTelemetry(frame.data(), frame.size(), *telemetry));
+    bytes += frame.size();
+    i = (i + 1) % frames->size();
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(bytes);
+  delete telemetry;
+}
+BENCHMARK(BM_ParseTelemetry);
+
+// What the server does per message: parse, plan and serialize the reply.
+// Frames are played in order and wrap around at the end.
+void BM_PlanFrame(benchmark::State &state) {
+  const RoadMap *road_map = loadRoadMap();
+  const vector<string> *frames = loadFrames();
+  if (!road_map || !frames) {
+    state.SkipWithError("no map or telemetry frames");
+    return;
+  }
+  ThreadPool pool;
+  PathPlanner *planner = new PathPlanner(*road_map, pool);
+  Telemetry *telemetry = new Telemetry;
+  ControlMessage control;
+  size_t i = 0;
+  double time = 0.0;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    const string &frame = (*frames)[i];
+    parseTelemetry(frame.data(), frame.size(), *telemetry);
+    // keeps the tracker's clock going forward across the wrap
+    time += 0.06;
+    planner->plan(*telemetry, time, control);
+    benchmark::DoNotOptimize(control.data());
+    i = (i + 1) % frames->size();
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations());
+  delete telemetry;
+  delete planner;
+}
+BENCHMARK(BM_PlanFrame)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
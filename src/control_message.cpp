@@ -0,0 +1,177 @@
+#include "control_message.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+const char kPrefix[] = "42[\"control\",{\"next_x\":[";
+const char kMiddle[] = "],\"next_y\":[";
+const char kSuffix[] = "]}]";
+
+// exact powers of ten in double and long double
+const double kPow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+const long double kPow10L[] = {
+  1e0L,  1e1L,  1e2L,  1e3L,  1e4L,  1e5L,  1e6L,  1e7L,  1e8L,  1e9L,
+  1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+  1e20L, 1e21L, 1e22L
+};
+
+// values handled by the integer path, [1e-5, 1e15)
+const int kMinExponent = -5;
+const int kMaxExponent = 14;
+
+// Writes m with a decimal point k digits from the right and drops trailing
+// zeros of the fraction.
+int writeFixed(uint64_t m, int k, bool negative, char *out) {
+  char digits[24];
+  int n = 0;
+  do {
+    digits[n++] = '0' + (char)(m % 10);
+    m /= 10;
+  } while (m);
+  // pad so there is at least one digit before the point
+  while (n <= k) {
+    digits[n++] = '0';
+  }
+  int skip = 0;
+  while (skip < k && digits[skip] == '0') {
+    ++skip;
+  }
+
+  char *p = out;
+  if (negative) {
+    *p++ = '-';
+  }
+  for (int i = n - 1; i >= k; --i) {
+    *p++ = digits[i];
+  }
+  if (skip < k) {
+    *p++ = '.';
+    for (int i = k - 1; i >= skip; --i) {
+      *p++ = digits[i];
+    }
+  }
+  return (int)(p - out);
+}
+
+}  // namespace
+
+// Digits are produced with integer arithmetic: scale |v| by 10^k so that p
+// significant digits land left of the point, round to an integer and print
+// that with the point put back. 15 and 16 digit candidates are checked by
+// dividing back, which is exact for mantissas below 2^53, or else by
+// comparing against the gap to the neighbouring double in long double, and
+// the first that reproduces v wins, so trailing zeros make it the shortest
+// one. 17 digits always read back when rounded to within half a unit,
+// which the 64 bit long double product guarantees. Anything else (huge,
+// tiny, or no extended precision) goes through printf with increasing
+// precision until the text reads back.
+int formatDouble(double v, char *out) {
+  if (v != v || v - v != 0.0) {
+    memcpy(out, "null", 4);
+    return 4;
+  }
+  if (v == 0.0) {
+    out[0] = '0';
+    return 1;
+  }
+  bool negative = v < 0.0;
+  double a = negative ? -v : v;
+
+  if (a >= 1e-5 && a < 1e15) {
+    // decimal exponent of the leading digit
+    int e10 = 0;
+    if (a >= 1.0) {
+      while (e10 < kMaxExponent && a >= kPow10[e10 + 1]) {
+        ++e10;
+      }
+    } else {
+      e10 = -1;
+      while (e10 > kMinExponent && a * kPow10[-e10] < 1.0) {
+        --e10;
+      }
+    }
+    for (int p = 15; p <= 16; ++p) {
+      int k = p - 1 - e10;
+      if (k < 0 || k > 22) {
+        continue;
+      }
+      long double scaled = (long double)a * kPow10L[k];
+      uint64_t m = (uint64_t)llroundl(scaled);
+      if (m < (1ULL << 53)) {
+        if ((double)m / kPow10[k] == a) {
+          return writeFixed(m, k, negative, out);
+        }
+      }
+#if LDBL_MANT_DIG >= 64
+      // too many bits to divide back exactly, instead check that the
+      // candidate is well within half the gap to the next lower double
+      else if (fabsl((long double)m - scaled) <
+               0.49L * (a - nextafter(a, 0.0)) * kPow10L[k]) {
+        return writeFixed(m, k, negative, out);
+      }
+#endif
+    }
+#if LDBL_MANT_DIG >= 64
+    int k = 16 - e10;
+    uint64_t m = (uint64_t)llroundl((long double)a * kPow10L[k]);
+    // e10 can come out one too high just below a power of ten
+    if (m < 10000000000000000ULL && k < 22) {
+      ++k;
+      m = (uint64_t)llroundl((long double)a * kPow10L[k]);
+    }
+    return writeFixed(m, k, negative, out);
+#endif
+  }
+  // %g drops trailing zeros, so for normal values 15 digits already give
+  // anything shorter; subnormals carry fewer digits and start at one
+  for (int p = a < DBL_MIN ? 1 : 15; p < 17; ++p) {
+    int n = snprintf(out, kMaxDoubleChars, "%.*g", p, v);
+    if (strtod(out, NULL) == v) {
+      return n;
+    }
+  }
+  return snprintf(out, kMaxDoubleChars, "%.17g", v);
+}
+
+ControlMessage::ControlMessage() : length_(0) {
+  buffer_.resize(1024);
+}
+
+void ControlMessage::build(const double *next_x, const double *next_y,
+                           int n) {
+  size_t needed = sizeof(kPrefix) + sizeof(kMiddle) + sizeof(kSuffix) +
+                  2 * (size_t)n * (kMaxDoubleChars + 1);
+  if (buffer_.size() < needed) {
+    buffer_.resize(needed);
+  }
+
+  char *p = &buffer_[0];
+  memcpy(p, kPrefix, sizeof(kPrefix) - 1);
+  p += sizeof(kPrefix) - 1;
+  for (int i = 0; i < n; ++i) {
+    if (i) {
+      *p++ = ',';
+    }
+    p += formatDouble(next_x[i], p);
+  }
+  memcpy(p, kMiddle, sizeof(kMiddle) - 1);
+  p += sizeof(kMiddle) - 1;
+  for (int i = 0; i < n; ++i) {
+    if (i) {
+      *p++ = ',';
+    }
+    p += formatDouble(next_y[i], p);
+  }
+  memcpy(p, kSuffix, sizeof(kSuffix) - 1);
+  p += sizeof(kSuffix) - 1;
+  length_ = p - &buffer_[0];
+}
@@ -0,0 +1,34 @@
+#ifndef CONTROL_MESSAGE_H
+#define CONTROL_MESSAGE_H
+
+#include <stddef.h>
+
+#include <vector>
+
+// Longest text formatDouble writes, e.g. -1.2345678901234567e-308
+const int kMaxDoubleChars = 32;
+
+// Writes the shortest decimal that reads back as exactly v (no terminating
+// null) and returns the number of characters written. out has to hold
+// kMaxDoubleChars. Negative zero is written as 0, NaN and infinities
+// become null as JSON has no representation for them.
+int formatDouble(double v, char *out);
+
+// Socket.io control frame 42["control",{"next_x":[...],"next_y":[...]}]
+// serialized straight into a buffer that is kept between messages, so
+// after the first few frames no memory is allocated.
+class ControlMessage {
+ public:
+  ControlMessage();
+
+  void build(const double *next_x, const double *next_y, int n);
+
+  const char *data() const { return &buffer_[0]; }
+  size_t length() const { return length_; }
+
+ private:
+  std::vector<char> buffer_;
+  size_t length_;
+};
+
+#endif /* CONTROL_MESSAGE_H */
@@ -0,0 +1,120 @@
+// Drives the planner against the headless simulator in process, as fast
+// as it goes, and reports the incidents. Exits with 1 if there were any.
+//
+// path_planning_sim [-t seconds] [-n cars] [-p points per cycle]
+//                   [-s seed] [-m map file] [-r log file]
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "control_message.h"
+#include "path_planner.h"
+#include "road_map.h"
+#include "simulator.h"
+#include "telemetry.h"
+#include "telemetry_log.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  double duration = 600.0;
+  SimulatorConfig config;
+  // same map and setup as the server
+  string map_file_ = "../data/highway_map.csv";
+  double max_s = 6945.554;
+  string log_file;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (i + 1 == argc) {
+      cerr << "Usage: " << argv[0] << " [-t seconds] [-n cars]"
+           << " [-p points per cycle] [-s seed] [-m map file] [-r log file]"
+           << endl;
+      return -1;
+    }
+    const char *value = argv[++i];
+    if (arg == "-t") {
+      duration = atof(value);
+    } else if (arg == "-n") {
+      config.num_cars = atoi(value);
+    } else if (arg == "-p") {
+      config.points_per_cycle = max(1, atoi(value));
+    } else if (arg == "-s") {
+      config.seed = (unsigned)atol(value);
+    } else if (arg == "-m") {
+      map_file_ = value;
+    } else if (arg == "-r") {
+      log_file = value;
+    } else {
+      cerr << "Unknown option " << arg << endl;
+      return -1;
+    }
+  }
+
+  RoadMap road_map;
+  if (!road_map.load(map_file_, max_s)) {
+    cerr << "Failed to load map " << map_file_ << endl;
+    return -1;
+  }
+  road_map.resample(0.5);
+
+  // optionally recorded like a live session, for path_planning_replay
+  TelemetryLogWriter log;
+  if (!log_file.empty() && !log.open(log_file)) {
+    return -1;
+  }
+
+  Simulator sim(road_map, config);
+  ThreadPool pool;
+  PathPlanner planner(road_map, pool);
+  unique_ptr<Telemetry> telemetry(new Telemetry);
+  ControlMessage control;
+  string message;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  while (sim.stats().time < duration) {
+    double time = sim.stats().time;
+    sim.telemetry(message);
+    log.append(kLogTelemetry, (int64_t)(time * 1e9), message.data(),
+               message.size());
+    if (parseTelemetry(message.data(), message.size(), *telemetry) !=
+        kTelemetryOk) {
+      cerr << "Failed to parse the simulator telemetry" << endl;
+      return -1;
+    }
+    planner.plan(*telemetry, time, control);
+    log.append(kLogControl, (int64_t)(time * 1e9), control.data(),
+               control.length());
+    if (!sim.control(control.data(), control.length())) {
+      cerr << "Failed to read the control message" << endl;
+    }
+  }
+  double wall_time = chrono::duration<double>(chrono::steady_clock::now() -
+                                              start).count();
+  if (!log.close()) {
+    return -1;
+  }
+
+  const SimulatorStats &stats = sim.stats();
+  double miles = stats.distance / 1609.344;
+  cout << "simulated:   " << stats.time << " s, " << miles << " miles ("
+       << miles / stats.time * 3600.0 << " MPH average)" << endl;
+  cout << "wall time:   " << wall_time << " s (" << stats.time / wall_time
+       << "x real time, " << miles / wall_time * 3600.0
+       << " miles per hour)" << endl;
+  cout << "cycles:      " << stats.cycles << endl;
+  cout << "collisions:  " << stats.collisions << endl;
+  cout << "max acc:     " << stats.acc_violations << endl;
+  cout << "max jerk:    " << stats.jerk_violations << endl;
+  cout << "speeding:    " << stats.speeding << endl;
+  cout << "off road:    " << stats.off_road << endl;
+
+  int incidents = stats.collisions + stats.acc_violations +
+                  stats.jerk_violations + stats.speeding + stats.off_road;
+  return incidents ? 1 : 0;
+}
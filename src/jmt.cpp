@@ -0,0 +1,72 @@
+#include "jmt.h"
+
+#include <assert.h>
+
+#include "Eigen-3.3/Eigen/LU"
+
+double QuinticPoly::eval(double t) const {
+  return c[0] + t * (c[1] + t * (c[2] + t * (c[3] + t * (c[4] + t * c[5]))));
+}
+
+double QuinticPoly::deriv(int order, double t) const {
+  assert(order >= 1 && order <= 3);
+  switch (order) {
+    case 1:
+      return c[1] + t * (2 * c[2] + t * (3 * c[3] + t * (4 * c[4] + t * 5 * c[5])));
+    case 2:
+      return 2 * c[2] + t * (6 * c[3] + t * (12 * c[4] + t * 20 * c[5]));
+    default:
+      return 6 * c[3] + t * (24 * c[4] + t * 60 * c[5]);
+  }
+}
+
+void QuinticPoly::evalBatch(double t0, double dt, int n, double *out) const {
+  for (int i = 0; i < n; ++i) {
+    double t = t0 + i * dt;
+    out[i] = c[0] + t * (c[1] + t * (c[2] + t * (c[3] + t * (c[4] + t * c[5]))));
+  }
+}
+
+void QuinticPoly::derivBatch(int order, double t0, double dt, int n,
+                             double *out) const {
+  for (int i = 0; i < n; ++i) {
+    out[i] = deriv(order, t0 + i * dt);
+  }
+}
+
+JMT::JMT(double T) : T_(T) {
+  assert(T > 0);
+  double T2 = T * T;
+  double T3 = T2 * T;
+  double T4 = T3 * T;
+  double T5 = T4 * T;
+
+  // end position, velocity and acceleration in terms of c3, c4, c5
+  Eigen::Matrix3d A;
+  A << T3, T4, T5,
+       3 * T2, 4 * T3, 5 * T4,
+       6 * T, 12 * T2, 20 * T3;
+  inv_ = A.inverse();
+}
+
+QuinticPoly JMT::solve(const double start[3], const double end[3]) const {
+  double T = T_;
+  double T2 = T * T;
+
+  QuinticPoly p;
+  p.c[0] = start[0];
+  p.c[1] = start[1];
+  p.c[2] = 0.5 * start[2];
+
+  // what is left of the end conditions after the start terms
+  Eigen::Vector3d b;
+  b << end[0] - (p.c[0] + p.c[1] * T + p.c[2] * T2),
+       end[1] - (p.c[1] + 2 * p.c[2] * T),
+       end[2] - 2 * p.c[2];
+  Eigen::Vector3d x = inv_ * b;
+
+  p.c[3] = x[0];
+  p.c[4] = x[1];
+  p.c[5] = x[2];
+  return p;
+}
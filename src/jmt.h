@@ -0,0 +1,40 @@
+#ifndef JMT_H
+#define JMT_H
+
+#include "Eigen-3.3/Eigen/Core"
+
+// Quintic polynomial p(t) = c[0] + c[1]*t + ... + c[5]*t^5
+struct QuinticPoly {
+  double c[6];
+
+  double eval(double t) const;
+  // order-th derivative, order = 1 (velocity), 2 (acceleration), 3 (jerk)
+  double deriv(int order, double t) const;
+  // out[i] = p(t0 + i*dt), i = 0..n-1
+  void evalBatch(double t0, double dt, int n, double *out) const;
+  void derivBatch(int order, double t0, double dt, int n, double *out) const;
+};
+
+// Jerk minimizing trajectory over a fixed horizon T.
+//
+// Start and end conditions are [position, velocity, acceleration]. The
+// first three coefficients follow directly from the start, the last three
+// from a 3x3 system that only depends on T, so its inverse is computed once
+// in the constructor and every solve is a 3x3 matrix-vector product. The
+// same object serves s(t) and d(t).
+class JMT {
+ public:
+  explicit JMT(double T);
+
+  double horizon() const { return T_; }
+  QuinticPoly solve(const double start[3], const double end[3]) const;
+
+ private:
+  double T_;
+  Eigen::Matrix3d inv_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+#endif /* JMT_H */
@@ -0,0 +1,153 @@
+#include "latency_stats.h"
+
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+// quantiles reported for every stage
+const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+const char *const kQuantileNames[] = {"p50", "p90", "p99", "p999"};
+const int kNumQuantiles = 4;
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram() : sum_(0), max_(0) {
+  for (int i = 0; i < kNumBuckets; ++i) {
+    counts_[i].store(0, memory_order_relaxed);
+  }
+}
+
+int LatencyHistogram::bucket(int64_t ns) {
+  if (ns < (1 << kSubBits)) {
+    return ns < 0 ? 0 : (int)ns;
+  }
+  int magnitude = 63 - __builtin_clzll((uint64_t)ns);
+  int shift = magnitude - kSubBits + 1;
+  if (shift > kMaxShift) {
+    return kNumBuckets - 1;
+  }
+  // ns >> shift is in [32, 64), the buckets of a shift follow those of
+  // the one below
+  return (shift << (kSubBits - 1)) + (int)(ns >> shift);
+}
+
+int64_t LatencyHistogram::bucketMax(int i) {
+  if (i < (1 << kSubBits)) {
+    return i;
+  }
+  int shift = (i >> (kSubBits - 1)) - 1;
+  int64_t sub = (i & ((1 << (kSubBits - 1)) - 1)) + (1 << (kSubBits - 1));
+  return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t ns) {
+  counts_[bucket(ns)].fetch_add(1, memory_order_relaxed);
+  sum_.fetch_add(ns < 0 ? 0 : ns, memory_order_relaxed);
+  int64_t seen = max_.load(memory_order_relaxed);
+  while (ns > seen &&
+         !max_.compare_exchange_weak(seen, ns, memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::count() const {
+  uint64_t total = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    total += counts_[i].load(memory_order_relaxed);
+  }
+  return total;
+}
+
+double LatencyHistogram::mean() const {
+  uint64_t n = count();
+  return n ? (double)sum() / n : 0.0;
+}
+
+int64_t LatencyHistogram::quantile(double q) const {
+  // one pass over a copy, so the rank and the walk see the same counts
+  uint64_t counts[kNumBuckets];
+  uint64_t total = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    counts[i] = counts_[i].load(memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)(q * total + 0.5);
+  rank = rank < 1 ? 1 : (rank > total ? total : rank);
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      int64_t value = bucketMax(i);
+      return value < max() ? value : max();
+    }
+  }
+  return max();
+}
+
+const char *LatencyStats::stageName(LatencyStage s) {
+  switch (s) {
+    case kStageParse: return "parse";
+    case kStagePrediction: return "prediction";
+    case kStageBehavior: return "behavior";
+    case kStageTrajectory: return "trajectory";
+    case kStageSerialize: return "serialize";
+    case kStageFrame: return "frame";
+    default: return "unknown";
+  }
+}
+
+string LatencyStats::json() const {
+  ostringstream out;
+  out << "{";
+  for (int s = 0; s < kNumLatencyStages; ++s) {
+    const LatencyHistogram &h = stages_[s];
+    out << (s ? "," : "") << "\"" << stageName((LatencyStage)s) << "\":{"
+        << "\"count\":" << h.count() << ",\"mean_us\":" << h.mean() * 1e-3;
+    for (int q = 0; q < kNumQuantiles; ++q) {
+      out << ",\"" << kQuantileNames[q] << "_us\":"
+          << h.quantile(kQuantiles[q]) * 1e-3;
+    }
+    out << ",\"max_us\":" << h.max() * 1e-3 << "}";
+  }
+  out << "}";
+  return out.str();
+}
+
+string LatencyStats::prometheus() const {
+  const char *name = "path_planning_stage_latency_seconds";
+  ostringstream out;
+  out << "# HELP " << name << " Time spent per telemetry frame by stage.\n"
+      << "# TYPE " << name << " summary\n";
+  for (int s = 0; s < kNumLatencyStages; ++s) {
+    const LatencyHistogram &h = stages_[s];
+    const char *stage = stageName((LatencyStage)s);
+    for (int q = 0; q < kNumQuantiles; ++q) {
+      out << name << "{stage=\"" << stage << "\",quantile=\"" << kQuantiles[q]
+          << "\"} " << h.quantile(kQuantiles[q]) * 1e-9 << "\n";
+    }
+    out << name << "_sum{stage=\"" << stage << "\"} " << h.sum() * 1e-9
+        << "\n"
+        << name << "_count{stage=\"" << stage << "\"} " << h.count() << "\n";
+  }
+  return out.str();
+}
+
+StageTimer::StageTimer(LatencyStats *stats) : stats_(stats) {
+  if (stats_) {
+    last_ = Clock::now();
+  }
+}
+
+void StageTimer::lap(LatencyStage stage) {
+  if (!stats_) {
+    return;
+  }
+  Clock::time_point now = Clock::now();
+  stats_->stage(stage).record(
+      chrono::duration_cast<chrono::nanoseconds>(now - last_).count());
+  last_ = now;
+}
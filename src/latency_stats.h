@@ -0,0 +1,86 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Stages of handling one telemetry message
+enum LatencyStage {
+  kStageParse,       // telemetry JSON into the Telemetry struct
+  kStagePrediction,  // traffic snapshot, tracks, prediction, occupancy
+  kStageBehavior,    // speed and lane decisions, maneuver search
+  kStageTrajectory,  // path generation and feasibility check
+  kStageSerialize,   // control message
+  kStageFrame,       // message received to reply ready, queueing included
+  kNumLatencyStages
+};
+
+// Histogram of latencies in nanoseconds with HDR style buckets: exact
+// below 64 ns, above that 32 buckets per power of two, so any value is
+// known to within 3% from 64 ns up to about half an hour (longer ones are
+// counted in the last bucket). Every bucket is an atomic counter, so any
+// number of threads can record without locking. Reading while others
+// record gives a slightly blurred but consistent enough view.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void record(int64_t ns);
+
+  uint64_t count() const;
+  double mean() const;
+  int64_t max() const { return max_.load(std::memory_order_relaxed); }
+  // smallest latency q of all samples are at or below, q in [0, 1]
+  int64_t quantile(double q) const;
+  uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+ private:
+  static const int kSubBits = 6;
+  static const int kMaxShift = 35;
+  static const int kNumBuckets = (kMaxShift + 2) << (kSubBits - 1);
+
+  static int bucket(int64_t ns);
+  // largest value counted in bucket i
+  static int64_t bucketMax(int i);
+
+  std::atomic<uint64_t> counts_[kNumBuckets];
+  std::atomic<uint64_t> sum_;
+  std::atomic<int64_t> max_;
+};
+
+// Latency histograms of all stages, shared by every session of a process.
+class LatencyStats {
+ public:
+  LatencyHistogram &stage(LatencyStage s) { return stages_[s]; }
+  const LatencyHistogram &stage(LatencyStage s) const { return stages_[s]; }
+
+  // {"parse":{"count":..,"mean_us":..,"p50_us":..,...},...}
+  std::string json() const;
+  // one summary metric labelled by stage, in the Prometheus text format
+  std::string prometheus() const;
+
+  static const char *stageName(LatencyStage s);
+
+ private:
+  LatencyHistogram stages_[kNumLatencyStages];
+};
+
+// Times consecutive stages: lap() records the time since the previous lap
+// (or construction) for a stage. Does nothing without stats.
+class StageTimer {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit StageTimer(LatencyStats *stats);
+
+  void lap(LatencyStage stage);
+
+ private:
+  LatencyStats *stats_;
+  Clock::time_point last_;
+};
+
+#endif /* LATENCY_STATS_H */
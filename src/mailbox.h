@@ -0,0 +1,51 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <atomic>
+
+// Single slot mailbox between one writer and one reader thread that always
+// hands over the newest value: a message the reader has not taken yet is
+// replaced by the next one.
+//
+// Three slots are cycled (triple buffering). The writer fills back(),
+// publish() swaps it with the shared slot, take() swaps the shared slot
+// with the reader's. Both are a single atomic exchange, neither side ever
+// blocks or copies a message.
+template <typename T>
+class Mailbox {
+ public:
+  Mailbox() : back_(0), shared_(1), front_(2) {}
+
+  // writer side
+  T &back() { return slots_[back_]; }
+  void publish() {
+    back_ = shared_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+            kIndex;
+  }
+
+  // reader side: true if a new message was moved to front()
+  bool take() {
+    if (!pending()) {
+      return false;
+    }
+    front_ = shared_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+    return true;
+  }
+  T &front() { return slots_[front_]; }
+
+  bool pending() const {
+    return (shared_.load(std::memory_order_acquire) & kFresh) != 0;
+  }
+
+ private:
+  static const int kIndex = 3;
+  static const int kFresh = 4;
+
+  T slots_[3];
+  int back_;
+  // index of the shared slot, kFresh set while it holds an untaken message
+  std::atomic<int> shared_;
+  int front_;
+};
+
+#endif /* MAILBOX_H */
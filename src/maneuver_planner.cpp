@@ -0,0 +1,139 @@
+#include "maneuver_planner.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+const double kSpeedLimit = 22.1;  // m/s, just below 50 MPH
+const double kMaxAcc = 10.0;      // m/s^2
+const double kMaxJerk = 50.0;     // m/s^3
+
+// candidate grid
+const double kHorizons[] = {2.0, 3.0, 4.0, 5.0};
+const double kMinSpeed = 8.0;
+const double kSpeedStep = 1.0;
+
+// margin kept around the ego position along s, together with the
+// footprint marked in the grid cars closer than 10 m are a collision
+const double kCollisionMargin = 7.5;
+
+// cost weights
+const double kCollisionCost = 1e6;
+const double kEfficiencyCost = 100.0;
+const double kLaneChangeCost = 10.0;
+const double kBufferCost = 50.0;
+const double kBufferDist = 10.0;
+
+}  // namespace
+
+ManeuverPlanner::ManeuverPlanner(ThreadPool &pool) : pool_(pool) {
+  int num_horizons = sizeof(kHorizons) / sizeof(kHorizons[0]);
+  for (int h = 0; h < num_horizons; ++h) {
+    jmts_.push_back(JMT(kHorizons[h]));
+  }
+  for (int lane = 0; lane < kNumLanes; ++lane) {
+    for (double v = kMinSpeed; v <= kSpeedLimit; v += kSpeedStep) {
+      for (int h = 0; h < num_horizons; ++h) {
+        Candidate c;
+        c.maneuver.lane = lane;
+        c.maneuver.target_speed = v;
+        c.maneuver.horizon = kHorizons[h];
+        c.jmt = h;
+        candidates_.push_back(c);
+      }
+    }
+  }
+  costs_.resize(candidates_.size());
+  done_.reset(new bool[candidates_.size()]);
+}
+
+ManeuverPlanner::Result ManeuverPlanner::plan(
+    const FrenetState &ego, const OccupancyGrid &grid,
+    const bool allowed[kNumLanes], chrono::microseconds budget) {
+  Frame frame = {&ego, &grid, allowed};
+  function<void(size_t)> task = [this, &frame](size_t i) {
+    costs_[i] = score(candidates_[i], frame);
+  };
+
+  Result result;
+  result.generated = candidates_.size();
+  result.evaluated = pool_.parallelFor(candidates_.size(), task,
+                                       ThreadPool::Clock::now() + budget,
+                                       done_.get());
+
+  // reduce to the cheapest candidate that was scored in time
+  result.found = false;
+  result.cost = numeric_limits<double>::infinity();
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    if (done_[i] && costs_[i] < result.cost) {
+      result.found = true;
+      result.cost = costs_[i];
+      result.best = candidates_[i].maneuver;
+    }
+  }
+  return result;
+}
+
+double ManeuverPlanner::score(const Candidate &candidate,
+                              const Frame &frame) const {
+  const Maneuver &m = candidate.maneuver;
+  if (!frame.allowed[m.lane]) {
+    return numeric_limits<double>::infinity();
+  }
+  const FrenetState &ego = *frame.ego;
+  const JMT &jmt = jmts_[candidate.jmt];
+  double T = jmt.horizon();
+
+  // s relative to the ego car, like the prediction
+  double start_s[3] = {0.0, ego.s_dot, ego.s_ddot};
+  double end_s[3] = {0.5 * (ego.s_dot + m.target_speed) * T, m.target_speed,
+                     0.0};
+  double start_d[3] = {ego.d, ego.d_dot, ego.d_ddot};
+  double end_d[3] = {kLaneWidth * (m.lane + 0.5), 0.0, 0.0};
+  QuinticPoly s = jmt.solve(start_s, end_s);
+  QuinticPoly d = jmt.solve(start_d, end_d);
+
+  // the trajectory is checked on the time steps of the grid, holding the
+  // end state once the horizon is reached
+  const OccupancyGrid &grid = *frame.grid;
+
+  double min_gap = numeric_limits<double>::infinity();
+  for (int k = 1; k <= grid.steps(); ++k) {
+    double t = k * grid.dt();
+    double s_t, d_t;
+    if (t <= T) {
+      s_t = s.eval(t);
+      d_t = d.eval(t);
+      double v = s.deriv(1, t);
+      double acc = sqrt(pow(s.deriv(2, t), 2) + pow(d.deriv(2, t), 2));
+      double jerk = sqrt(pow(s.deriv(3, t), 2) + pow(d.deriv(3, t), 2));
+      if (v < 0.0 || v > kSpeedLimit || acc > kMaxAcc || jerk > kMaxJerk) {
+        return numeric_limits<double>::infinity();
+      }
+    } else {
+      s_t = end_s[0] + m.target_speed * (t - T);
+      d_t = end_d[0];
+    }
+
+    int lane0, lane1;
+    OccupancyGrid::lanesAt(d_t, lane0, lane1);
+    for (int l = lane0; l >= 0 && l <= lane1; ++l) {
+      if (grid.occupied(k, l, s_t - kCollisionMargin, s_t + kCollisionMargin)) {
+        return kCollisionCost;
+      }
+      min_gap = min(min_gap, grid.gapAhead(k, l, s_t));
+    }
+  }
+
+  int ego_lane = (int)(ego.d / kLaneWidth);
+  double cost = kEfficiencyCost * (kSpeedLimit - m.target_speed) / kSpeedLimit;
+  cost += kLaneChangeCost * abs(m.lane - ego_lane);
+  cost += kBufferCost * exp(-min_gap / kBufferDist);
+  return cost;
+}
@@ -0,0 +1,72 @@
+#ifndef MANEUVER_PLANNER_H
+#define MANEUVER_PLANNER_H
+
+#include <stddef.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "jmt.h"
+#include "occupancy_grid.h"
+#include "thread_pool.h"
+
+// Drive to the center of lane at target_speed, reached after horizon.
+struct Maneuver {
+  int lane;
+  double target_speed;  // m/s
+  double horizon;       // s
+};
+
+// Ego state in Frenet coordinates
+struct FrenetState {
+  double s, s_dot, s_ddot;
+  double d, d_dot, d_ddot;
+};
+
+// Generates candidate maneuvers (lane x target speed x horizon) as jerk
+// minimizing trajectories in s and d and scores them in parallel on the
+// thread pool. Candidates still unscored when the time budget runs out
+// are left out of the reduction.
+class ManeuverPlanner {
+ public:
+  struct Result {
+    bool found;
+    Maneuver best;
+    double cost;
+    size_t evaluated;  // candidates scored before the deadline
+    size_t generated;
+  };
+
+  explicit ManeuverPlanner(ThreadPool &pool);
+
+  // grid holds the predicted occupancy relative to ego.s, candidates are
+  // checked against it on its time steps. allowed[l] says whether lane l
+  // may be the target lane.
+  Result plan(const FrenetState &ego, const OccupancyGrid &grid,
+              const bool allowed[kNumLanes],
+              std::chrono::microseconds budget);
+
+ private:
+  struct Candidate {
+    Maneuver maneuver;
+    int jmt;  // index into jmts_
+  };
+  // inputs of the frame being planned, shared by the workers
+  struct Frame {
+    const FrenetState *ego;
+    const OccupancyGrid *grid;
+    const bool *allowed;
+  };
+
+  double score(const Candidate &candidate, const Frame &frame) const;
+
+  ThreadPool &pool_;
+  std::vector<JMT> jmts_;  // one per horizon
+  std::vector<Candidate> candidates_;
+  // per frame results, sized once
+  std::vector<double> costs_;
+  std::unique_ptr<bool[]> done_;
+};
+
+#endif /* MANEUVER_PLANNER_H */
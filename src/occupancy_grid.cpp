@@ -0,0 +1,105 @@
+#include "occupancy_grid.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+// bits first..last of a word set
+uint64_t mask(int first, int last) {
+  uint64_t high = last == 63 ? ~0ULL : (1ULL << (last + 1)) - 1;
+  return high & ~((1ULL << first) - 1);
+}
+
+void setRange(uint64_t *row, int first, int last) {
+  for (int w = first / 64; w <= last / 64; ++w) {
+    int lo = max(first, w * 64) - w * 64;
+    int hi = min(last, w * 64 + 63) - w * 64;
+    row[w] |= mask(lo, hi);
+  }
+}
+
+bool anyInRange(const uint64_t *row, int first, int last) {
+  for (int w = first / 64; w <= last / 64; ++w) {
+    int lo = max(first, w * 64) - w * 64;
+    int hi = min(last, w * 64 + 63) - w * 64;
+    if (row[w] & mask(lo, hi)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+OccupancyGrid::OccupancyGrid()
+    : dt_(kPredictionDt), steps_(0),
+      bins_((int)ceil((kGridMaxS - kGridMinS) / kGridBin)),
+      words_((bins_ + 63) / 64) {
+}
+
+int OccupancyGrid::bin(double s) const {
+  return (int)floor((s - kGridMinS) / kGridBin);
+}
+
+void OccupancyGrid::lanesAt(double d, int &first, int &last) {
+  first = (int)floor((d - kVehicleHalfWidth) / kLaneWidth);
+  last = (int)floor((d + kVehicleHalfWidth) / kLaneWidth);
+  first = max(first, 0);
+  last = min(last, kNumLanes - 1);
+  if (first > last) {
+    first = last = -1;
+  }
+}
+
+void OccupancyGrid::build(const Prediction &prediction) {
+  dt_ = prediction.dt();
+  steps_ = prediction.steps();
+  // sized for the first prediction, later ones reuse the storage
+  bits_.assign((steps_ + 1) * kNumLanes * words_, 0);
+
+  for (int k = 0; k <= steps_; ++k) {
+    const double *s = prediction.s(k);
+    const double *d = prediction.d(k);
+    for (int c = 0; c < prediction.size(); ++c) {
+      int first = max(bin(s[c] - kVehicleHalfLength), 0);
+      int last = min(bin(s[c] + kVehicleHalfLength), bins_ - 1);
+      if (first > last) {
+        continue;
+      }
+      int lane0, lane1;
+      lanesAt(d[c], lane0, lane1);
+      for (int l = lane0; l >= 0 && l <= lane1; ++l) {
+        setRange(row(k, l), first, last);
+      }
+    }
+  }
+}
+
+bool OccupancyGrid::occupied(int step, int lane, double s0, double s1) const {
+  int first = max(bin(s0), 0);
+  int last = min(bin(s1), bins_ - 1);
+  return first <= last && anyInRange(row(step, lane), first, last);
+}
+
+double OccupancyGrid::gapAhead(int step, int lane, double s) const {
+  int first = max(bin(s) + 1, 0);
+  if (first >= bins_) {
+    return numeric_limits<double>::infinity();
+  }
+  const uint64_t *r = row(step, lane);
+  int w = first / 64;
+  uint64_t word = r[w] & ~((1ULL << (first % 64)) - 1);
+  while (!word) {
+    if (++w == words_) {
+      return numeric_limits<double>::infinity();
+    }
+    word = r[w];
+  }
+  int b = w * 64 + __builtin_ctzll(word);
+  return kGridMinS + b * kGridBin - s;
+}
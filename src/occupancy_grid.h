@@ -0,0 +1,60 @@
+#ifndef OCCUPANCY_GRID_H
+#define OCCUPANCY_GRID_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "prediction.h"
+
+// s range covered relative to the ego car and bin size, in meters
+const double kGridMinS = -100.0;
+const double kGridMaxS = 300.0;
+const double kGridBin = 1.0;
+
+// footprint marked around each predicted vehicle position
+const double kVehicleHalfLength = 2.5;
+const double kVehicleHalfWidth = 1.0;
+
+// Which (s bin, lane) cells are taken by another vehicle at each time
+// step of the prediction, one bit per cell.
+//
+// Rows of bits along s are kept per step and lane, so checking a
+// trajectory sample is a masked test of the one or two words under it
+// instead of a loop over all vehicles. s is relative to the ego car like
+// the prediction, anything outside [kGridMinS, kGridMaxS) is free.
+class OccupancyGrid {
+ public:
+  OccupancyGrid();
+
+  void build(const Prediction &prediction);
+
+  // True if any vehicle in lane covers part of [s0, s1] at step
+  bool occupied(int step, int lane, double s0, double s1) const;
+  // Distance from s to the nearest occupied cell ahead in lane at step,
+  // infinity if there is none up to kGridMaxS
+  double gapAhead(int step, int lane, double s) const;
+
+  // Lanes touched by a vehicle centered at d, -1 when off the road
+  static void lanesAt(double d, int &first, int &last);
+
+  double dt() const { return dt_; }
+  int steps() const { return steps_; }
+
+ private:
+  int bin(double s) const;
+  const uint64_t *row(int step, int lane) const {
+    return &bits_[(step * kNumLanes + lane) * words_];
+  }
+  uint64_t *row(int step, int lane) {
+    return &bits_[(step * kNumLanes + lane) * words_];
+  }
+
+  double dt_;
+  int steps_;
+  int bins_;
+  int words_;  // 64 bit words per row
+  std::vector<uint64_t> bits_;
+};
+
+#endif /* OCCUPANCY_GRID_H */
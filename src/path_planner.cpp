@@ -0,0 +1,371 @@
+#include "path_planner.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "spline.h"
+
+using namespace std;
+
+namespace {
+
+// For converting back and forth between radians and degrees.
+constexpr double pi() { return M_PI; }
+double deg2rad(double x) { return x * pi() / 180; }
+
+// Comfort limits the simulator checks the path against
+const double max_acc = 10.0;   // m/s^2
+const double max_jerk = 50.0;  // m/s^3
+
+// Upper bound on the speed of other cars, used to size search windows
+const double max_traffic_speed = 40.0;  // m/s
+
+// Time the maneuver planner may spend scoring candidates per frame
+const chrono::microseconds planning_budget(5000);
+
+}  // namespace
+
+PathPlanner::PathPlanner(const RoadMap &road_map, ThreadPool &pool,
+                         LatencyStats *stats)
+    : road_map_(road_map), maneuver_planner_(pool), stats_(stats),
+      //start in lane 1 and at rest
+      lane_(1), vel_ref_(0.0), vel_max_(49.5),
+      //default Menu = 1 (Keep Lane)
+      menu_item_(1) {
+}
+
+void PathPlanner::plan(const Telemetry &telemetry, double time,
+                       ControlMessage &control) {
+  StageTimer timer(stats_);
+
+  // Main car's localization Data
+  double car_x = telemetry.x;
+  double car_y = telemetry.y;
+  double car_s = telemetry.s;
+  double car_d = telemetry.d;
+  double car_yaw = telemetry.yaw;
+  double car_speed = telemetry.speed;
+
+  // Previous path data given to the Planner
+  const double *previous_path_x = telemetry.previous_path_x;
+  const double *previous_path_y = telemetry.previous_path_y;
+  // Previous path's end s and d values
+  double end_path_s = telemetry.end_path_s;
+
+  // Sensor Fusion Data, a list of all other cars on the same side of the road.
+  traffic_.build(telemetry);
+  lanes_.build(traffic_, road_map_.max_s());
+  tracker_.update(traffic_, road_map_, time);
+
+  // path sent back: what is left of the previous path plus new points
+  double next_x_vals[kMaxPathPoints];
+  double next_y_vals[kMaxPathPoints];
+  int num_next = 0;
+
+  //store previous path size, never more than a full path
+  const int path_size = 50;
+  int prev_size = telemetry.prev_size;
+  if(prev_size > path_size)
+  {
+     prev_size = path_size;
+     //the points dropped from the end don't count for end_path_s
+     double end_path_d;
+     road_map_.getFrenet(telemetry.previous_path_x[prev_size-1],
+                         telemetry.previous_path_y[prev_size-1],
+                         end_path_s, end_path_d);
+  }
+
+  //get our car s position (since car_s overwritten with endpath below if prev_size > 0)
+  double car_s_pos = car_s;
+
+  //set s coordinate of the car to end of previous path
+  if(prev_size > 0)
+  {
+     car_s = end_path_s;
+  }
+  //keep it on the same side of the wraparound at max_s as our car
+  car_s = car_s_pos + lanes_.delta(car_s_pos, car_s);
+
+  //predict the other cars relative to our position: on a time grid turned into
+  //an occupancy grid for the lane change checks and the maneuver planner, and
+  //at the end of the previous path for the front car check
+  double horizon = (double)prev_size * 0.02;
+  prediction_.predict(traffic_, tracker_, car_s_pos, road_map_.max_s(),
+                     kConstantAcceleration | kLateralDrift);
+  double proj_s[kMaxVehicles];
+  double proj_d[kMaxVehicles];
+  prediction_.at(horizon, proj_s, proj_d);
+  occupancy_.build(prediction_);
+  timer.lap(kStagePrediction);
+
+
+  //boolean variable will be set to true if we encounter cars in our lane
+  bool too_close = false;
+  //keep track of front car speed if vehicle too close,
+  // so that we can adapt our speed
+  double front_speed = 0.0;
+
+
+  // Look at the cars in our lane, or predicted to move into it, that can be
+  // in front of us at the end of the previous path. If one comes closer
+  // than 30 meters set too_close variable to TRUE and track ID of
+  // the nearest one. Later we will adapt our speed based on this
+  int nearby[kMaxVehicles];
+  double front_gap = 30;
+  for(int l = max(0, lane_-1); l <= min(kNumLanes-1, lane_+1); ++l)
+  {
+     int num_nearby = lanes_.inRange(l, car_s - horizon * max_traffic_speed, car_s + 30, nearby);
+     for(int k = 0; k < num_nearby; ++k)
+     {
+        int i = nearby[k];
+        if(l != lane_ && (int)floor(proj_d[i] / kLaneWidth) != lane_)
+        {
+           continue;
+        }
+        double check_speed = traffic_.speed[i];
+        //predicted s coordinate of the car at the end of our previous path
+        double check_car_s = car_s_pos + proj_s[i];
+        //check for cars in front if future paths collide
+        if((check_car_s > car_s) && ((check_car_s - car_s) < front_gap) )
+        {
+           too_close = true;
+           front_speed = check_speed;
+           front_gap = check_car_s - car_s;
+        }
+     }
+  }
+  //if front vehicle too close decrease speed until we are driving
+  // at roughly same speed. Else approach the speed limit, or the lower
+  // speed the path ahead can be driven at
+  double vel_target = min(49.5, vel_max_);
+  if(too_close && (vel_ref_ > front_speed))
+  {
+     vel_ref_ -= 0.2;
+  }
+  else if(vel_ref_ > vel_target)
+  {
+     vel_ref_ -= min(0.224, vel_ref_ - vel_target);
+  }
+  else if(vel_ref_ < vel_target)
+  {
+     vel_ref_ += min(0.224, vel_target - vel_ref_);
+  }
+
+  //defining some variables to manage lane change decisions
+  bool change_left = true;
+  bool change_right = true;
+
+  //implement switch as a state machine to manage lane changes
+  switch(menu_item_) {
+     //case menuItem=1 equals KEEP LANE
+     case(1): if(too_close)
+     {
+        menu_item_ = 2;
+     }
+     break;
+     //case menuItem=2 equals PREPARE LANE CHANGE
+     case(2):
+
+     // Assert viability of left and right lane changes: the target lane has
+     // to stay clear from 15 meters behind to 5 meters ahead of us at every
+     // predicted time step until we reach the end of the previous path.
+     {
+        int last_step = min(occupancy_.steps(), (int)ceil(horizon / occupancy_.dt()));
+
+        // check space in left lane (only if I am in lane 1 or 2), then
+        // the same is done for the right lane (only if I am in lane 0 or 1)
+        for(int side = -1; side <= 1; side += 2)
+        {
+           bool &change = (side < 0) ? change_left : change_right;
+           int target_lane = lane_ + side;
+           if(target_lane < 0 || target_lane >= kNumLanes)
+           {
+              change = false;
+              continue;
+           }
+           for(int k = 0; k <= last_step && change; ++k)
+           {
+              //our position along the previous path relative to where we are now
+              double ego_s = 0.0;
+              if(horizon > 0.0)
+              {
+                 ego_s = (car_s - car_s_pos) * min(1.0, k * occupancy_.dt() / horizon);
+              }
+              if(occupancy_.occupied(k, target_lane, ego_s - 15, ego_s + 5))
+              {
+                 change = false;
+              }
+           }
+        }
+     }
+     // Next we let the maneuver planner score keeping the lane against the
+     // viable lane changes: it rolls out candidate trajectories over target
+     // lane, speed and horizon and picks the cheapest (safety, speed, comfort).
+     {
+        bool allowed[kNumLanes] = {false, false, false};
+        allowed[lane_] = true;
+        if(change_left && lane_ > 0)
+        {
+           allowed[lane_-1] = true;
+        }
+        if(change_right && lane_ < kNumLanes-1)
+        {
+           allowed[lane_+1] = true;
+        }
+
+        FrenetState ego = {car_s_pos, car_speed/2.24, 0.0, car_d, 0.0, 0.0};
+        ManeuverPlanner::Result result =
+            maneuver_planner_.plan(ego, occupancy_, allowed, planning_budget);
+        if(result.found && result.best.lane < lane_)
+        {
+           menu_item_ = 3;
+        }
+        else if(result.found && result.best.lane > lane_)
+        {
+           menu_item_ = 4;
+        }
+     }
+     break;
+     //case menuItem=3 equals LANE CHANGE LEFT
+     case(3):
+     lane_ -= 1;
+     menu_item_ = 1;
+     break;
+     //case menuItem=4 equals LANE CHANGE RIGHT
+     case(4):
+     lane_ += 1;
+     menu_item_ = 1;
+     break;
+  }
+  timer.lap(kStageBehavior);
+
+  // define a path made up of (x,y) points that the car will visit sequentially every .02 seconds
+  // two reference points plus three anchors ahead
+  const int num_pts = 5;
+  double ptsx[num_pts];
+  double ptsy[num_pts];
+
+  double ref_x = car_x;
+  double ref_y = car_y;
+  double ref_yaw = deg2rad(car_yaw);
+
+
+  if(prev_size < 2)
+  {
+    //use two points that make path tangent to previus path's end point
+    double prev_car_x = car_x - cos(car_yaw);
+    double prev_car_y = car_y - sin(car_yaw);
+
+    ptsx[0] = prev_car_x;
+    ptsx[1] = car_x;
+
+    ptsy[0] = prev_car_y;
+    ptsy[1] = car_y;
+
+  }
+  else
+  {
+    ref_x = previous_path_x[prev_size-1];
+    ref_y = previous_path_y[prev_size-1];
+
+    double ref_x_prev = previous_path_x[prev_size-2];
+    double ref_y_prev = previous_path_y[prev_size-2];
+    ref_yaw = atan2(ref_y-ref_y_prev,ref_x-ref_x_prev);
+
+    //use two points that make path tangent to previus path's end point
+    ptsx[0] = ref_x_prev;
+    ptsx[1] = ref_x;
+
+    ptsy[0] = ref_y_prev;
+    ptsy[1] = ref_y;
+  }
+  //In Frenet add evenly 30m spaced points ahead of the starting reference (in target lane)
+  double next_s[3] = {car_s+30, car_s+60, car_s+90};
+  double next_d[3] = {(double)(2+4*lane_), (double)(2+4*lane_), (double)(2+4*lane_)};
+  double next_x[3], next_y[3];
+  road_map_.getXY(next_s, next_d, next_x, next_y, 3);
+
+  for(int i = 0; i < 3; ++i)
+  {
+     ptsx[2+i] = next_x[i];
+     ptsy[2+i] = next_y[i];
+  }
+
+
+  for(int i = 0; i < num_pts; ++i)
+  {
+     //shift car reference angle to 0 degrees
+     double shift_x = (ptsx[i]-ref_x);
+     double shift_y = (ptsy[i]-ref_y);
+
+     ptsx[i] = ((shift_x * cos(0-ref_yaw)) - (shift_y * sin(0-ref_yaw)));
+     ptsy[i] = ((shift_x * sin(0-ref_yaw)) + (shift_y * cos(0-ref_yaw)));
+  }
+  //create spline (fixed capacity, so no heap allocation per frame)
+  tk::static_spline<8> s;
+
+  //set (x,y) points to the spline
+  s.set_points(ptsx,ptsy,num_pts);
+
+  for(int i = 0; i < prev_size; ++i)
+  {
+    next_x_vals[num_next] = previous_path_x[i];
+    next_y_vals[num_next] = previous_path_y[i];
+    ++num_next;
+  }
+  //place the new points at exact arc length steps along the spline
+  //so the car travels at the desired target velocity
+  tk::arc_length_sampler<8> path_len;
+  path_len.build(s.view());
+
+  int num_new = path_size - prev_size;
+  double xs[path_size];
+  double ys[path_size];
+  path_len.sample(0.0, 0.02*vel_ref_/2.24, num_new, xs, ys);
+
+  //feasibility check: lateral acceleration v^2*k and jerk v^3*dk/ds
+  //along the new part of the path straight from the spline derivatives
+  double dy1[path_size], dy2[path_size], dy3[path_size];
+  s.deriv_batch_sorted(1, xs, dy1, num_new);
+  s.deriv_batch_sorted(2, xs, dy2, num_new);
+  s.deriv_batch_sorted(3, xs, dy3, num_new);
+  double v_max = 49.5/2.24;
+  for(int i = 0; i < num_new; ++i)
+  {
+    double slope2 = 1.0 + dy1[i]*dy1[i];
+    double curvature = fabs(dy2[i])/pow(slope2, 1.5);
+    double curvature_rate = fabs(dy3[i]*slope2 - 3.0*dy1[i]*dy2[i]*dy2[i])/pow(slope2, 3.0);
+    if(curvature > 0.0)
+    {
+      v_max = min(v_max, sqrt(max_acc/curvature));
+    }
+    if(curvature_rate > 0.0)
+    {
+      v_max = min(v_max, cbrt(max_jerk/curvature_rate));
+    }
+  }
+  //the speed ramp above slows down to it over the next frames
+  vel_max_ = v_max*2.24;
+
+  double cos_yaw = cos(ref_yaw);
+  double sin_yaw = sin(ref_yaw);
+  for(int i = 0; i < num_new; ++i)
+  {
+    //rotate back to normal coordinates
+    double x_point = (xs[i] * cos_yaw-ys[i]*sin_yaw);
+    double y_point = (xs[i] * sin_yaw+ys[i]*cos_yaw);
+
+    x_point += ref_x;
+    y_point += ref_y;
+
+    next_x_vals[num_next] = x_point;
+    next_y_vals[num_next] = y_point;
+    ++num_next;
+  }
+  timer.lap(kStageTrajectory);
+
+  control.build(next_x_vals, next_y_vals, num_next);
+  timer.lap(kStageSerialize);
+}
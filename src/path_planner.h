@@ -0,0 +1,51 @@
+#ifndef PATH_PLANNER_H
+#define PATH_PLANNER_H
+
+#include "control_message.h"
+#include "latency_stats.h"
+#include "maneuver_planner.h"
+#include "occupancy_grid.h"
+#include "prediction.h"
+#include "road_map.h"
+#include "telemetry.h"
+#include "thread_pool.h"
+#include "traffic.h"
+#include "vehicle_tracker.h"
+
+// Behavior and path planning for one car: turns a telemetry frame into the
+// control message with the next path. The lane state machine and the
+// traffic history are kept from frame to frame.
+class PathPlanner {
+ public:
+  // the time spent per stage goes to stats if given
+  PathPlanner(const RoadMap &road_map, ThreadPool &pool,
+              LatencyStats *stats = NULL);
+
+  // time is the arrival of the frame in seconds, on any clock that does
+  // not jump (the tracker derives accelerations from it)
+  void plan(const Telemetry &telemetry, double time, ControlMessage &control);
+
+ private:
+  const RoadMap &road_map_;
+  ManeuverPlanner maneuver_planner_;
+  LatencyStats *stats_;
+
+  // the other vehicles unpacked into columns, rebuilt for every frame
+  TrafficSnapshot traffic_;
+  LaneIndex lanes_;
+  // history of every vehicle across frames
+  VehicleTracker tracker_;
+  Prediction prediction_;
+  OccupancyGrid occupancy_;
+
+  // target lane
+  int lane_;
+  // reference velocity in MPH
+  double vel_ref_;
+  // highest velocity the last path could be driven at, in MPH
+  double vel_max_;
+  // state machine: 1 keep lane, 2 prepare lane change, 3/4 change left/right
+  int menu_item_;
+};
+
+#endif /* PATH_PLANNER_H */
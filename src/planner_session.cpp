@@ -0,0 +1,50 @@
+#include "planner_session.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+PlannerSession::PlannerSession(uv_loop_t *loop, const RoadMap &road_map,
+                               ThreadPool &pool, uWS::WebSocket<uWS::SERVER> ws,
+                               LatencyStats *stats, const string &log_path)
+    : ws_(ws), start_time_(chrono::steady_clock::now()),
+      planner_(road_map, pool, stats),
+      thread_(loop, planner_, [this](const ControlMessage &control) {
+        log_.append(kLogControl, elapsedNs(), control.data(),
+                    control.length());
+        ws_.send(control.data(), control.length(), uWS::OpCode::TEXT);
+      }, stats) {
+  if (!log_path.empty()) {
+    log_.open(log_path);
+  }
+  ws_.setUserData(this);
+}
+
+int64_t PlannerSession::elapsedNs() const {
+  return chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now() - start_time_).count();
+}
+
+void PlannerSession::onMessage(const char *data, size_t length) {
+  int64_t now = elapsedNs();
+  log_.append(kLogTelemetry, now, data, length);
+  TelemetryStatus status = thread_.post(data, length, now * 1e-9);
+
+  if (status == kTelemetryManual) {
+    // Manual driving
+    string msg = "42[\"manual\",{}]";
+    ws_.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
+  } else if (status == kTelemetryMalformed) {
+    cerr << "Dropping malformed telemetry message" << endl;
+  }
+}
+
+void PlannerSession::close() {
+  ws_.setUserData(NULL);
+  thread_.close([this] { delete this; });
+}
+
+PlannerSession *PlannerSession::of(uWS::WebSocket<uWS::SERVER> ws) {
+  return static_cast<PlannerSession *>(ws.getUserData());
+}
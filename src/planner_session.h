@@ -0,0 +1,59 @@
+#ifndef PLANNER_SESSION_H
+#define PLANNER_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <string>
+
+#include <uWS/uWS.h>
+
+#include "latency_stats.h"
+#include "path_planner.h"
+#include "planner_thread.h"
+#include "road_map.h"
+#include "telemetry_log.h"
+#include "thread_pool.h"
+
+// Everything one connected simulator needs: its own planner state and
+// planner thread, answering on its own websocket.
+//
+// A session is created when a client connects and attached to the socket
+// as user data, so several simulators can be driven by one process without
+// sharing lane or speed targets, and a reconnect starts from scratch. Only
+// the road map and the worker pool are shared.
+//
+// With a log path every message in and out is recorded with its time, for
+// path_planning_replay.
+class PlannerSession {
+ public:
+  PlannerSession(uv_loop_t *loop, const RoadMap &road_map, ThreadPool &pool,
+                 uWS::WebSocket<uWS::SERVER> ws,
+                 LatencyStats *stats = NULL,
+                 const std::string &log_path = "");
+
+  // Event loop thread: handles one message from the simulator
+  void onMessage(const char *data, size_t length);
+
+  // Detaches from the socket. The session deletes itself once the planner
+  // thread has stopped, it must not be used after this.
+  void close();
+
+  // the session attached to ws, NULL if there is none
+  static PlannerSession *of(uWS::WebSocket<uWS::SERVER> ws);
+
+ private:
+  ~PlannerSession() {}
+
+  // time since the session started
+  int64_t elapsedNs() const;
+
+  uWS::WebSocket<uWS::SERVER> ws_;
+  std::chrono::steady_clock::time_point start_time_;
+  TelemetryLogWriter log_;
+  PathPlanner planner_;
+  PlannerThread thread_;
+};
+
+#endif /* PLANNER_SESSION_H */
@@ -0,0 +1,90 @@
+#include "planner_thread.h"
+
+using namespace std;
+
+PlannerThread::PlannerThread(uv_loop_t *loop, PathPlanner &planner,
+                             const ReplyCallback &on_reply,
+                             LatencyStats *stats)
+    : planner_(planner), on_reply_(on_reply), stats_(stats), stop_(false) {
+  uv_async_init(loop, &async_, &PlannerThread::onAsync);
+  async_.data = this;
+  thread_ = thread(&PlannerThread::run, this);
+}
+
+PlannerThread::~PlannerThread() {
+  stop();
+}
+
+void PlannerThread::stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wakeup_.notify_one();
+  thread_.join();
+}
+
+void PlannerThread::close(const CloseCallback &on_closed) {
+  stop();
+  on_closed_ = on_closed;
+  uv_close(reinterpret_cast<uv_handle_t *>(&async_), &PlannerThread::onClose);
+}
+
+void PlannerThread::onClose(uv_handle_t *handle) {
+  PlannerThread *self = static_cast<PlannerThread *>(handle->data);
+  // the callback may well destroy us, don't run it out of a member
+  CloseCallback on_closed = self->on_closed_;
+  on_closed();
+}
+
+TelemetryStatus PlannerThread::post(const char *data, size_t length,
+                                    double time) {
+  Frame &frame = frames_.back();
+  frame.received = StageTimer::Clock::now();
+  StageTimer timer(stats_);
+  TelemetryStatus status = parseTelemetry(data, length, frame.telemetry);
+  if (status == kTelemetryOk) {
+    timer.lap(kStageParse);
+    frame.time = time;
+    frames_.publish();
+    // taking the lock orders the notify after the planner's check of the
+    // mailbox, so the wakeup can't get lost
+    { lock_guard<mutex> lock(mutex_); }
+    wakeup_.notify_one();
+  }
+  return status;
+}
+
+void PlannerThread::onAsync(uv_async_t *handle) {
+  PlannerThread *self = static_cast<PlannerThread *>(handle->data);
+  // uv may merge several sends into one callback, only the newest reply
+  // matters anyway
+  if (self->replies_.take()) {
+    self->on_reply_(self->replies_.front());
+  }
+}
+
+void PlannerThread::run() {
+  while (true) {
+    {
+      unique_lock<mutex> lock(mutex_);
+      wakeup_.wait(lock, [this] { return stop_ || frames_.pending(); });
+      if (stop_) {
+        return;
+      }
+    }
+    frames_.take();
+    const Frame &frame = frames_.front();
+    planner_.plan(frame.telemetry, frame.time, replies_.back());
+    if (stats_) {
+      stats_->stage(kStageFrame).record(
+          chrono::duration_cast<chrono::nanoseconds>(
+              StageTimer::Clock::now() - frame.received).count());
+    }
+    replies_.publish();
+    uv_async_send(&async_);
+  }
+}
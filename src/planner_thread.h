@@ -0,0 +1,77 @@
+#ifndef PLANNER_THREAD_H
+#define PLANNER_THREAD_H
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <uv.h>
+
+#include "control_message.h"
+#include "latency_stats.h"
+#include "mailbox.h"
+#include "path_planner.h"
+#include "telemetry.h"
+
+// Runs a PathPlanner on a thread of its own so planning never blocks the
+// websocket event loop.
+//
+// The event loop thread parses each message straight into a mailbox that
+// keeps only the newest frame, so after a burst the planner works on the
+// latest telemetry instead of a queue of stale ones. Control messages go
+// back through a second mailbox and a uv async handle, the reply callback
+// runs on the event loop thread.
+class PlannerThread {
+ public:
+  typedef std::function<void(const ControlMessage &)> ReplyCallback;
+  typedef std::function<void()> CloseCallback;
+
+  // stats (if given) gets the parse time and the time from receiving a
+  // frame to its reply being ready
+  PlannerThread(uv_loop_t *loop, PathPlanner &planner,
+                const ReplyCallback &on_reply, LatencyStats *stats = NULL);
+  // stops and joins the thread
+  ~PlannerThread();
+
+  // Stops the thread and releases the async handle while the event loop
+  // keeps running. on_closed is called from the loop once uv is done with
+  // the handle, only then may the PlannerThread be destroyed.
+  void close(const CloseCallback &on_closed);
+
+  // Event loop thread: parses the message and hands telemetry frames to
+  // the planner, time is when it arrived (see PathPlanner::plan). Returns
+  // the parse status, the caller answers everything that is not telemetry.
+  TelemetryStatus post(const char *data, size_t length, double time);
+
+ private:
+  struct Frame {
+    Telemetry telemetry;
+    double time;
+    StageTimer::Clock::time_point received;
+  };
+
+  static void onAsync(uv_async_t *handle);
+  static void onClose(uv_handle_t *handle);
+  void stop();
+  void run();
+
+  PathPlanner &planner_;
+  ReplyCallback on_reply_;
+  CloseCallback on_closed_;
+  LatencyStats *stats_;
+  uv_async_t async_;
+
+  Mailbox<Frame> frames_;
+  Mailbox<ControlMessage> replies_;
+
+  // only used to sleep while there is no frame, the mailboxes don't lock
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  bool stop_;
+  std::thread thread_;
+};
+
+#endif /* PLANNER_THREAD_H */
@@ -0,0 +1,78 @@
+#include "prediction.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// estimated accelerations are noisy, limit what we extrapolate
+const double kMaxPredictedAcc = 5.0;  // m/s^2
+// lateral speeds below this are treated as lane keeping
+const double kMinDriftSpeed = 0.2;    // m/s
+// a lane change takes about this long, drift is not continued beyond
+const double kMaxDriftTime = 2.0;     // s
+// samples averaged for the lateral speed
+const int kDriftSamples = 5;
+
+const double kNoStop = 1e9;
+
+}  // namespace
+
+Prediction::Prediction(double dt, int steps)
+    : dt_(dt), steps_(steps), size_(0),
+      s_((steps + 1) * kMaxVehicles), d_((steps + 1) * kMaxVehicles) {
+}
+
+void Prediction::predict(const TrafficSnapshot &traffic,
+                         const VehicleTracker &tracker, double origin_s,
+                         double max_s, int models) {
+  size_ = traffic.size;
+  for (int i = 0; i < size_; ++i) {
+    double rel_s = fmod(traffic.s[i] - origin_s, max_s);
+    if (rel_s >= 0.5 * max_s) {
+      rel_s -= max_s;
+    } else if (rel_s < -0.5 * max_s) {
+      rel_s += max_s;
+    }
+    s0_[i] = rel_s;
+    d0_[i] = traffic.d[i];
+    vs_[i] = traffic.speed[i];
+    as_[i] = 0.0;
+    vd_[i] = 0.0;
+    t_stop_[i] = kNoStop;
+
+    const VehicleTracker::Track *track = tracker.track(i);
+    if (!track) {
+      continue;
+    }
+    vs_[i] = max(0.0, track->latest().vs);
+    if (models & kConstantAcceleration) {
+      double a = track->accelerationS();
+      as_[i] = max(-kMaxPredictedAcc, min(kMaxPredictedAcc, a));
+      if (as_[i] < 0.0) {
+        t_stop_[i] = -vs_[i] / as_[i];
+      }
+    }
+    if (models & kLateralDrift) {
+      double vd = track->lateralSpeed(kDriftSamples);
+      vd_[i] = fabs(vd) < kMinDriftSpeed ? 0.0 : vd;
+    }
+  }
+
+  for (int k = 0; k <= steps_; ++k) {
+    at(k * dt_, &s_[k * kMaxVehicles], &d_[k * kMaxVehicles]);
+  }
+}
+
+void Prediction::at(double t, double *s, double *d) const {
+  const double t_drift = min(t, kMaxDriftTime);
+  // plain loop over the columns, the compiler vectorizes it
+  for (int i = 0; i < size_; ++i) {
+    double tt = min(t, t_stop_[i]);
+    s[i] = s0_[i] + (vs_[i] + 0.5 * as_[i] * tt) * tt;
+    d[i] = d0_[i] + vd_[i] * t_drift;
+  }
+}
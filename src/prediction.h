@@ -0,0 +1,63 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#include <vector>
+
+#include "traffic.h"
+#include "vehicle_tracker.h"
+
+// Default time grid: every 0.1 s for 6 s
+const double kPredictionDt = 0.1;
+const int kPredictionSteps = 60;
+
+// Terms of the motion model on top of constant velocity along the lane
+enum PredictionModel {
+  kConstantVelocity = 0,
+  kConstantAcceleration = 1,  // longitudinal acceleration from the track
+  kLateralDrift = 2           // lateral speed from the track
+};
+
+// Predicted Frenet positions of every vehicle on a fixed time grid.
+//
+// Positions are stored time major as struct of arrays, s(k)[i] and d(k)[i]
+// for vehicle i of the snapshot at t = k*dt, so a collision check of a
+// trajectory sample against all vehicles is a pass over two contiguous
+// arrays. s is measured from an origin (usually the ego car) and wrapped
+// around the loop, so it compares directly with ego offsets.
+class Prediction {
+ public:
+  explicit Prediction(double dt = kPredictionDt,
+                      int steps = kPredictionSteps);
+
+  // models is a combination of PredictionModel flags. Vehicles without a
+  // track fall back to constant velocity.
+  void predict(const TrafficSnapshot &traffic, const VehicleTracker &tracker,
+               double origin_s, double max_s, int models);
+
+  // Positions of all vehicles at an arbitrary time t
+  void at(double t, double *s, double *d) const;
+
+  double dt() const { return dt_; }
+  int steps() const { return steps_; }
+  int size() const { return size_; }
+  // rows of the grid, step 0..steps()
+  const double *s(int step) const { return &s_[step * kMaxVehicles]; }
+  const double *d(int step) const { return &d_[step * kMaxVehicles]; }
+
+ private:
+  double dt_;
+  int steps_;
+  int size_;
+  // per vehicle model: s(t) = s0 + vs*t' + as/2*t'^2 with t' = min(t,
+  // t_stop) so braking cars stop, d(t) = d0 + vd*min(t, kMaxDriftTime)
+  double s0_[kMaxVehicles];
+  double vs_[kMaxVehicles];
+  double as_[kMaxVehicles];
+  double t_stop_[kMaxVehicles];
+  double d0_[kMaxVehicles];
+  double vd_[kMaxVehicles];
+  std::vector<double> s_;
+  std::vector<double> d_;
+};
+
+#endif /* PREDICTION_H */
@@ -0,0 +1,179 @@
+// Feeds recorded telemetry logs through the planner offline, as fast as it
+// goes with one thread per log, and reports the planning throughput. Every
+// log is replayed from its start by one planner, so the replies have to
+// match the recorded ones; the exit status is non-zero if any differs.
+//
+// path_planning_replay [-j threads] [-m map file] <log>...
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "control_message.h"
+#include "latency_stats.h"
+#include "path_planner.h"
+#include "road_map.h"
+#include "telemetry.h"
+#include "telemetry_log.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+struct Totals {
+  Totals() : frames(0), replies(0), differing(0), plan_time(0.0) {}
+
+  long frames;
+  long replies;
+  long differing;
+  double plan_time;
+};
+
+// The planner carries speed, lane and vehicle histories from frame to
+// frame, so a log can't be cut into pieces replayed on their own.
+void replayLog(const TelemetryLogReader &log, const RoadMap &road_map,
+               ThreadPool &pool, LatencyStats &stats, Totals &totals) {
+  unique_ptr<PathPlanner> planner(new PathPlanner(road_map, pool, &stats));
+  unique_ptr<Telemetry> telemetry(new Telemetry);
+  ControlMessage control;
+  bool planned = false;
+
+  for (size_t i = 0; i < log.size(); ++i) {
+    LogRecord record = log.record(i);
+    if (record.type == kLogTelemetry) {
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      StageTimer timer(&stats);
+      if (parseTelemetry(record.data, record.length, *telemetry) !=
+          kTelemetryOk) {
+        continue;
+      }
+      timer.lap(kStageParse);
+      planner->plan(*telemetry, record.time_ns * 1e-9, control);
+      chrono::nanoseconds elapsed = chrono::duration_cast<chrono::nanoseconds>(
+          chrono::steady_clock::now() - start);
+      stats.stage(kStageFrame).record(elapsed.count());
+      totals.plan_time += elapsed.count() * 1e-9;
+      planned = true;
+      ++totals.frames;
+    } else if (record.type == kLogControl && planned) {
+      // a maneuver search cut short by its time budget at another point
+      // than in the recording shows up here as well
+      ++totals.replies;
+      if (record.length != control.length() ||
+          memcmp(record.data, control.data(), control.length()) != 0) {
+        ++totals.differing;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int num_threads = max(1, (int)thread::hardware_concurrency());
+  // same map and setup as the server
+  string map_file_ = "../data/highway_map.csv";
+  double max_s = 6945.554;
+  vector<string> log_files;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      num_threads = max(1, atoi(argv[++i]));
+    } else if (arg == "-m" && i + 1 < argc) {
+      map_file_ = argv[++i];
+    } else {
+      log_files.push_back(arg);
+    }
+  }
+  if (log_files.empty()) {
+    cerr << "Usage: " << argv[0] << " [-j threads] [-m map file] <log>..."
+         << endl;
+    return -1;
+  }
+
+  RoadMap road_map;
+  if (!road_map.load(map_file_, max_s)) {
+    cerr << "Failed to load map " << map_file_ << endl;
+    return -1;
+  }
+  road_map.resample(0.5);
+
+  vector<unique_ptr<TelemetryLogReader> > logs;
+  for (size_t i = 0; i < log_files.size(); ++i) {
+    unique_ptr<TelemetryLogReader> log(new TelemetryLogReader);
+    if (!log->open(log_files[i])) {
+      return -1;
+    }
+    if (!log->indexed()) {
+      cerr << log_files[i] << " has no index, recovered " << log->size()
+           << " records" << endl;
+    }
+    logs.push_back(move(log));
+  }
+
+  // replay threads pull logs until none are left, the maneuver search of
+  // all of them shares one pool
+  ThreadPool pool;
+  LatencyStats stats;
+  atomic<size_t> next_log(0);
+  Totals totals;
+  mutex totals_mutex;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  vector<thread> threads;
+  num_threads = min(num_threads, (int)logs.size());
+  for (int t = 0; t < num_threads; ++t) {
+    threads.push_back(thread([&] {
+      Totals local;
+      size_t l;
+      while ((l = next_log++) < logs.size()) {
+        replayLog(*logs[l], road_map, pool, stats, local);
+      }
+      lock_guard<mutex> lock(totals_mutex);
+      totals.frames += local.frames;
+      totals.replies += local.replies;
+      totals.differing += local.differing;
+      totals.plan_time += local.plan_time;
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  double wall_time = chrono::duration<double>(chrono::steady_clock::now() -
+                                              start).count();
+
+  cout << "logs:        " << logs.size() << " (on " << num_threads
+       << " threads)" << endl;
+  cout << "frames:      " << totals.frames << endl;
+  cout << "wall time:   " << wall_time << " s" << endl;
+  if (totals.frames > 0) {
+    cout << "per frame:   " << totals.plan_time / totals.frames * 1e6
+         << " us" << endl;
+    cout << "throughput:  " << totals.frames / wall_time << " frames/s"
+         << endl;
+  }
+  cout << "replies:     " << totals.replies << " recorded, "
+       << totals.differing << " differ from the replay" << endl;
+  cout << "latency in us (p50 / p99 / p999 / max):" << endl;
+  for (int s = 0; s < kNumLatencyStages; ++s) {
+    const LatencyHistogram &h = stats.stage((LatencyStage)s);
+    cout << "  " << LatencyStats::stageName((LatencyStage)s) << ": "
+         << h.quantile(0.5) * 1e-3 << " / " << h.quantile(0.99) * 1e-3
+         << " / " << h.quantile(0.999) * 1e-3 << " / " << h.max() * 1e-3
+         << endl;
+  }
+  if (totals.differing > 0) {
+    cerr << "Replay differs from the recording" << endl;
+    return -1;
+  }
+  return 0;
+}
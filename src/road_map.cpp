@@ -0,0 +1,414 @@
+#include "road_map.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "spline.h"
+
+using namespace std;
+
+namespace {
+
+// side length of a grid cell in meters. Segments are registered in every
+// cell within this distance, so any query closer than that to the road
+// finds its segment in its own cell.
+const double kCellSize = 50.0;
+
+// waypoints repeated on each side of the loop so the splines are smooth
+// across max_s
+const int kWrapPoints = 3;
+
+// how far getFrenet may walk along the nodes from the waypoint estimate
+const int kMaxWalk = 64;
+
+double distance(double x1, double y1, double x2, double y2) {
+  return sqrt((x2-x1)*(x2-x1)+(y2-y1)*(y2-y1));
+}
+
+// length and unit heading of the closed polyline x,y
+void computeSegments(const vector<double> &x, const vector<double> &y,
+                     vector<double> &len, vector<double> &ux,
+                     vector<double> &uy) {
+  int n = x.size();
+  len.resize(n);
+  ux.resize(n);
+  uy.resize(n);
+  for (int i = 0; i < n; ++i) {
+    int j = (i + 1) % n;
+    len[i] = distance(x[i], y[i], x[j], y[j]);
+    ux[i] = (x[j] - x[i]) / len[i];
+    uy[i] = (y[j] - y[i]) / len[i];
+  }
+}
+
+}  // namespace
+
+RoadMap::RoadMap()
+    : max_s_(0.0), step_(0.0), grid_x0_(0.0), grid_y0_(0.0),
+      cell_size_(kCellSize), grid_w_(0), grid_h_(0) {}
+
+bool RoadMap::load(const string &map_file, double max_s) {
+  ifstream in_map_(map_file.c_str(), ifstream::in);
+  if (!in_map_.is_open()) {
+    return false;
+  }
+
+  wp_x_.clear();
+  wp_y_.clear();
+  wp_s_.clear();
+  wp_dx_.clear();
+  wp_dy_.clear();
+
+  string line;
+  while (getline(in_map_, line)) {
+    istringstream iss(line);
+    double x;
+    double y;
+    float s;
+    float d_x;
+    float d_y;
+    iss >> x;
+    iss >> y;
+    iss >> s;
+    iss >> d_x;
+    iss >> d_y;
+    wp_x_.push_back(x);
+    wp_y_.push_back(y);
+    wp_s_.push_back(s);
+    wp_dx_.push_back(d_x);
+    wp_dy_.push_back(d_y);
+  }
+
+  if (wp_x_.size() < 3) {
+    return false;
+  }
+
+  max_s_ = max_s;
+  computeSegments(wp_x_, wp_y_, wp_len_, wp_ux_, wp_uy_);
+  buildGrid();
+
+  // until resampled the lookups run on the waypoints themselves
+  x_ = wp_x_;
+  y_ = wp_y_;
+  s_ = wp_s_;
+  nx_.clear();
+  ny_.clear();
+  step_ = 0.0;
+  computeSegments(x_, y_, seg_len_, seg_ux_, seg_uy_);
+  return true;
+}
+
+void RoadMap::resample(double spacing) {
+  int n = size();
+
+  // knots: the last waypoints shifted by -max_s, all waypoints, then the
+  // first ones shifted by +max_s
+  vector<double> knot_s, knot_x, knot_y, knot_dx, knot_dy;
+  for (int k = -kWrapPoints; k < n + kWrapPoints; ++k) {
+    int i = (k + n) % n;
+    double offset = k < 0 ? -max_s_ : (k >= n ? max_s_ : 0.0);
+    knot_s.push_back(wp_s_[i] + offset);
+    knot_x.push_back(wp_x_[i]);
+    knot_y.push_back(wp_y_[i]);
+    knot_dx.push_back(wp_dx_[i]);
+    knot_dy.push_back(wp_dy_[i]);
+  }
+
+  tk::spline spline_x, spline_y, spline_dx, spline_dy;
+  spline_x.set_points(knot_s, knot_x);
+  spline_y.set_points(knot_s, knot_y);
+  spline_dx.set_points(knot_s, knot_dx);
+  spline_dy.set_points(knot_s, knot_dy);
+
+  // uniform step so that node i sits exactly at s = i*step
+  int num_nodes = max(3, (int)round(max_s_ / spacing));
+  step_ = max_s_ / num_nodes;
+
+  x_.resize(num_nodes);
+  y_.resize(num_nodes);
+  s_.resize(num_nodes);
+  nx_.resize(num_nodes);
+  ny_.resize(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    double s = i * step_;
+    s_[i] = s;
+    x_[i] = spline_x(s);
+    y_[i] = spline_y(s);
+    double n_x = spline_dx(s);
+    double n_y = spline_dy(s);
+    double norm = sqrt(n_x * n_x + n_y * n_y);
+    nx_[i] = n_x / norm;
+    ny_[i] = n_y / norm;
+  }
+  computeSegments(x_, y_, seg_len_, seg_ux_, seg_uy_);
+}
+
+void RoadMap::buildGrid() {
+  int n = size();
+  double x_min = *min_element(wp_x_.begin(), wp_x_.end()) - cell_size_;
+  double y_min = *min_element(wp_y_.begin(), wp_y_.end()) - cell_size_;
+  double x_max = *max_element(wp_x_.begin(), wp_x_.end()) + cell_size_;
+  double y_max = *max_element(wp_y_.begin(), wp_y_.end()) + cell_size_;
+
+  grid_x0_ = x_min;
+  grid_y0_ = y_min;
+  grid_w_ = (int)ceil((x_max - x_min) / cell_size_);
+  grid_h_ = (int)ceil((y_max - y_min) / cell_size_);
+
+  // cell range covered by the bounding box of segment i grown by one cell
+  struct CellRange { int cx0, cy0, cx1, cy1; };
+  vector<CellRange> ranges(n);
+  for (int i = 0; i < n; ++i) {
+    int j = (i + 1) % n;
+    CellRange &r = ranges[i];
+    r.cx0 = (int)((min(wp_x_[i], wp_x_[j]) - cell_size_ - grid_x0_) / cell_size_);
+    r.cy0 = (int)((min(wp_y_[i], wp_y_[j]) - cell_size_ - grid_y0_) / cell_size_);
+    r.cx1 = (int)((max(wp_x_[i], wp_x_[j]) + cell_size_ - grid_x0_) / cell_size_);
+    r.cy1 = (int)((max(wp_y_[i], wp_y_[j]) + cell_size_ - grid_y0_) / cell_size_);
+    r.cx0 = max(r.cx0, 0);
+    r.cy0 = max(r.cy0, 0);
+    r.cx1 = min(r.cx1, grid_w_ - 1);
+    r.cy1 = min(r.cy1, grid_h_ - 1);
+  }
+
+  // counting pass, then fill
+  grid_start_.assign(grid_w_ * grid_h_ + 1, 0);
+  for (int i = 0; i < n; ++i) {
+    const CellRange &r = ranges[i];
+    for (int cy = r.cy0; cy <= r.cy1; ++cy) {
+      for (int cx = r.cx0; cx <= r.cx1; ++cx) {
+        grid_start_[cellIndex(cx, cy) + 1]++;
+      }
+    }
+  }
+  for (size_t c = 1; c < grid_start_.size(); ++c) {
+    grid_start_[c] += grid_start_[c - 1];
+  }
+  grid_segments_.resize(grid_start_.back());
+  vector<int> fill(grid_start_.begin(), grid_start_.end() - 1);
+  for (int i = 0; i < n; ++i) {
+    const CellRange &r = ranges[i];
+    for (int cy = r.cy0; cy <= r.cy1; ++cy) {
+      for (int cx = r.cx0; cx <= r.cx1; ++cx) {
+        grid_segments_[fill[cellIndex(cx, cy)]++] = i;
+      }
+    }
+  }
+}
+
+double RoadMap::waypointDistance2(int i, double x, double y, double &t) const {
+  double x_x = x - wp_x_[i];
+  double x_y = y - wp_y_[i];
+  double proj = x_x * wp_ux_[i] + x_y * wp_uy_[i];
+  proj = max(0.0, min(proj, wp_len_[i]));
+  t = proj / wp_len_[i];
+  double e_x = x_x - proj * wp_ux_[i];
+  double e_y = x_y - proj * wp_uy_[i];
+  return e_x * e_x + e_y * e_y;
+}
+
+double RoadMap::segmentDistance2(int i, double x, double y, double &t) const {
+  double x_x = x - x_[i];
+  double x_y = y - y_[i];
+  double proj = x_x * seg_ux_[i] + x_y * seg_uy_[i];
+  proj = max(0.0, min(proj, seg_len_[i]));
+  t = proj / seg_len_[i];
+  double e_x = x_x - proj * seg_ux_[i];
+  double e_y = x_y - proj * seg_uy_[i];
+  return e_x * e_x + e_y * e_y;
+}
+
+int RoadMap::closestWaypointSegment(double x, double y) const {
+  double best = 1e300;
+  int best_seg = 0;
+  double t;
+
+  int cx = (int)floor((x - grid_x0_) / cell_size_);
+  int cy = (int)floor((y - grid_y0_) / cell_size_);
+  if (cx >= 0 && cx < grid_w_ && cy >= 0 && cy < grid_h_) {
+    int c = cellIndex(cx, cy);
+    for (int k = grid_start_[c]; k < grid_start_[c + 1]; ++k) {
+      int i = grid_segments_[k];
+      double dist2 = waypointDistance2(i, x, y, t);
+      if (dist2 < best) {
+        best = dist2;
+        best_seg = i;
+      }
+    }
+  }
+
+  // anything within one cell of the road is guaranteed to be in the cell,
+  // only points far off the road need the full scan
+  if (best > cell_size_ * cell_size_) {
+    for (int i = 0; i < size(); ++i) {
+      double dist2 = waypointDistance2(i, x, y, t);
+      if (dist2 < best) {
+        best = dist2;
+        best_seg = i;
+      }
+    }
+  }
+  return best_seg;
+}
+
+int RoadMap::ClosestWaypoint(double x, double y) const {
+  // the closest waypoint is one of the ends of the waypoint segment
+  // holding the closest road point
+  double s, d;
+  getFrenet(x, y, s, d);
+  int prev_wp = max((int)(upper_bound(wp_s_.begin(), wp_s_.end(), s) -
+                          wp_s_.begin()) - 1, 0);
+  int next_wp = (prev_wp + 1) % size();
+
+  double prev_dist = distance(x, y, wp_x_[prev_wp], wp_y_[prev_wp]);
+  double next_dist = distance(x, y, wp_x_[next_wp], wp_y_[next_wp]);
+  return next_dist < prev_dist ? next_wp : prev_wp;
+}
+
+int RoadMap::NextWaypoint(double x, double y, double theta) const {
+  int closestWaypoint = ClosestWaypoint(x,y);
+
+  double map_x = wp_x_[closestWaypoint];
+  double map_y = wp_y_[closestWaypoint];
+
+  double heading = atan2( (map_y-y),(map_x-x) );
+
+  double angle = fabs(theta-heading);
+
+  if (angle > M_PI/4) {
+    closestWaypoint = (closestWaypoint + 1) % size();
+  }
+
+  return closestWaypoint;
+}
+
+void RoadMap::getFrenet(double x, double y, double &s, double &d) const {
+  // coarse s from the waypoint grid
+  int wp = closestWaypointSegment(x, y);
+  double t;
+  waypointDistance2(wp, x, y, t);
+  double s_est = wp_s_[wp] + t * wp_len_[wp];
+
+  // then walk along the nodes until the projection falls inside a segment
+  int n = numNodes();
+  int seg = segmentAt(wrapS(s_est));
+  int dir = 0;
+  for (int k = 0; k < kMaxWalk; ++k) {
+    segmentDistance2(seg, x, y, t);
+    int next = t <= 0.0 ? -1 : (t >= 1.0 ? 1 : 0);
+    if (next == 0 || next == -dir) {
+      break;
+    }
+    dir = next;
+    seg = (seg + next + n) % n;
+  }
+
+  // d is positive to the right of the driving direction, which is where
+  // the dx,dy normals of the map point to
+  double x_x = x - x_[seg];
+  double x_y = y - y_[seg];
+  if (step_ > 0.0) {
+    // invert segmentXY: solve x_x,x_y = t*e + d*n(t) with the normal
+    // lerped at the current t, a couple of rounds are plenty at 0.5 m
+    int j = (seg + 1) % n;
+    double e_x = x_[j] - x_[seg];
+    double e_y = y_[j] - y_[seg];
+    for (int k = 0; k < 3; ++k) {
+      double n_x = nx_[seg] + t * (nx_[j] - nx_[seg]);
+      double n_y = ny_[seg] + t * (ny_[j] - ny_[seg]);
+      double det = e_x * n_y - e_y * n_x;
+      t = (x_x * n_y - x_y * n_x) / det;
+      d = (e_x * x_y - e_y * x_x) / det;
+    }
+    s = s_[seg] + t * step_;
+  } else {
+    d = x_x * seg_uy_[seg] - x_y * seg_ux_[seg];
+    s = s_[seg] + t * seg_len_[seg];
+  }
+  if (s < 0) {
+    s += max_s_;
+  }
+  if (s >= max_s_) {
+    s -= max_s_;
+  }
+}
+
+double RoadMap::wrapS(double s) const {
+  s = fmod(s, max_s_);
+  if (s < 0) {
+    s += max_s_;
+  }
+  return s;
+}
+
+int RoadMap::segmentAt(double s) const {
+  if (step_ > 0.0) {
+    return min((int)(s / step_), numNodes() - 1);
+  }
+  int i = (int)(upper_bound(s_.begin(), s_.end(), s) - s_.begin()) - 1;
+  return max(i, 0);
+}
+
+void RoadMap::segmentXY(int i, double s, double d, double &x, double &y) const {
+  if (step_ > 0.0) {
+    // lerp position and normal between the two nodes
+    int j = (i + 1) % numNodes();
+    double t = (s - s_[i]) / step_;
+    double n_x = nx_[i] + t * (nx_[j] - nx_[i]);
+    double n_y = ny_[i] + t * (ny_[j] - ny_[i]);
+    x = x_[i] + t * (x_[j] - x_[i]) + d * n_x;
+    y = y_[i] + t * (y_[j] - y_[i]) + d * n_y;
+  } else {
+    double seg_s = s - s_[i];
+    // right hand normal of the heading (ux,uy) is (uy,-ux)
+    x = x_[i] + seg_s * seg_ux_[i] + d * seg_uy_[i];
+    y = y_[i] + seg_s * seg_uy_[i] - d * seg_ux_[i];
+  }
+}
+
+void RoadMap::getXY(double s, double d, double &x, double &y) const {
+  s = wrapS(s);
+  segmentXY(segmentAt(s), s, d, x, y);
+}
+
+void RoadMap::getFrenetVelocity(double s, double vx, double vy, double &vs,
+                                double &vd) const {
+  int i = segmentAt(wrapS(s));
+  vs = vx * seg_ux_[i] + vy * seg_uy_[i];
+  vd = vx * seg_uy_[i] - vy * seg_ux_[i];
+}
+
+void RoadMap::getXY(const double *s, const double *d, double *x, double *y,
+                    size_t n) const {
+  if (step_ > 0.0) {
+    // uniform table, the segment is a direct index
+    for (size_t k = 0; k < n; ++k) {
+      double s_k = wrapS(s[k]);
+      segmentXY(segmentAt(s_k), s_k, d[k], x[k], y[k]);
+    }
+    return;
+  }
+
+  // a couple of forward steps are cheaper than a fresh binary search
+  const int kMaxSteps = 4;
+
+  int seg = -1;
+  for (size_t k = 0; k < n; ++k) {
+    double s_k = wrapS(s[k]);
+    int steps = 0;
+    if (seg >= 0 && s_k >= s_[seg]) {
+      while (steps < kMaxSteps && s_k >= segmentEndS(seg) &&
+             seg + 1 < numNodes()) {
+        ++seg;
+        ++steps;
+      }
+    }
+    if (seg < 0 || s_k < s_[seg] || s_k >= segmentEndS(seg)) {
+      seg = segmentAt(s_k);
+    }
+    segmentXY(seg, s_k, d[k], x[k], y[k]);
+  }
+}
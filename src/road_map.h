@@ -0,0 +1,119 @@
+#ifndef ROAD_MAP_H
+#define ROAD_MAP_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+// Road geometry built once at startup from the waypoint map.
+//
+// Caches per-segment lengths, cumulative s and headings, plus a uniform
+// grid over the waypoint segments so that Cartesian -> Frenet conversion
+// only looks at the handful of segments around the query point instead of
+// scanning every waypoint. Segment i goes from node i to node i+1, the last
+// one closes the loop back to node 0 at max_s.
+//
+// Lookups run on a list of centerline nodes. After load() these are the
+// waypoints themselves (piecewise linear road); resample() replaces them by
+// a dense table sampled from splines through the waypoints, which makes
+// Frenet <-> Cartesian a table lookup plus one lerp on a smooth centerline.
+class RoadMap {
+ public:
+  RoadMap();
+
+  // Reads x,y,s,dx,dy waypoints from the map file and builds the caches.
+  // Returns false if the file could not be read or holds < 3 waypoints.
+  bool load(const std::string &map_file, double max_s);
+
+  // Fits splines x(s), y(s), dx(s), dy(s) through the waypoints (wrapping
+  // around at max_s) and resamples them every ~spacing meters.
+  void resample(double spacing);
+
+  int ClosestWaypoint(double x, double y) const;
+  int NextWaypoint(double x, double y, double theta) const;
+
+  // Transform from Cartesian x,y coordinates to Frenet s,d coordinates
+  void getFrenet(double x, double y, double &s, double &d) const;
+
+  // Transform from Frenet s,d coordinates to Cartesian x,y
+  void getXY(double s, double d, double &x, double &y) const;
+  // Batch version writing n points into caller provided buffers. Runs of
+  // increasing s (e.g. samples along a path) walk the segments forward
+  // instead of searching for every point.
+  void getXY(const double *s, const double *d, double *x, double *y,
+             size_t n) const;
+
+  // Splits the Cartesian velocity vx,vy of a vehicle at s into its
+  // components along the road (vs) and towards increasing d (vd)
+  void getFrenetVelocity(double s, double vx, double vy, double &vs,
+                         double &vd) const;
+
+  int size() const { return (int)wp_x_.size(); }
+  double max_s() const { return max_s_; }
+
+  const std::vector<double> &waypoints_x() const { return wp_x_; }
+  const std::vector<double> &waypoints_y() const { return wp_y_; }
+  const std::vector<double> &waypoints_s() const { return wp_s_; }
+  const std::vector<double> &waypoints_dx() const { return wp_dx_; }
+  const std::vector<double> &waypoints_dy() const { return wp_dy_; }
+
+ private:
+  void buildGrid();
+  int cellIndex(int cx, int cy) const { return cy * grid_w_ + cx; }
+  // distance^2 from (x,y) to waypoint segment i, t is the clamped
+  // projection [0,1]
+  double waypointDistance2(int i, double x, double y, double &t) const;
+  // same for node segment i
+  double segmentDistance2(int i, double x, double y, double &t) const;
+  int closestWaypointSegment(double x, double y) const;
+
+  int numNodes() const { return (int)x_.size(); }
+  // s wrapped into [0, max_s)
+  double wrapS(double s) const;
+  // node segment containing the (wrapped) s
+  int segmentAt(double s) const;
+  double segmentEndS(int i) const {
+    return i + 1 < numNodes() ? s_[i + 1] : max_s_;
+  }
+  void segmentXY(int i, double s, double d, double &x, double &y) const;
+
+  double max_s_;
+
+  // raw waypoints as read from the map file
+  std::vector<double> wp_x_;
+  std::vector<double> wp_y_;
+  std::vector<double> wp_s_;
+  std::vector<double> wp_dx_;
+  std::vector<double> wp_dy_;
+  // per waypoint segment: length and unit heading vector
+  std::vector<double> wp_len_;
+  std::vector<double> wp_ux_;
+  std::vector<double> wp_uy_;
+
+  // centerline nodes used for lookups, with unit normals pointing to the
+  // right of the driving direction (only set once resampled)
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> s_;
+  std::vector<double> nx_;
+  std::vector<double> ny_;
+  std::vector<double> seg_len_;
+  std::vector<double> seg_ux_;
+  std::vector<double> seg_uy_;
+  // uniform node spacing in s after resample(), 0 for the raw waypoints
+  double step_;
+
+  // uniform grid over the waypoint segments in compressed row storage:
+  // the segments touching cell c are
+  // grid_segments_[grid_start_[c] .. grid_start_[c+1])
+  double grid_x0_;
+  double grid_y0_;
+  double cell_size_;
+  int grid_w_;
+  int grid_h_;
+  std::vector<int> grid_start_;
+  std::vector<int> grid_segments_;
+};
+
+#endif /* ROAD_MAP_H */
@@ -0,0 +1,102 @@
+#include "server.h"
+
+#include <iostream>
+#include <string>
+
+#include <uWS/uWS.h>
+
+#include "planner_session.h"
+
+using namespace std;
+
+Server::Server(const RoadMap &road_map, ThreadPool &pool, int num_shards,
+               const string &log_prefix)
+    : road_map_(road_map), pool_(pool), num_shards_(num_shards),
+      log_prefix_(log_prefix), num_sessions_(0) {
+  if (num_shards_ <= 0) {
+    num_shards_ = max(1, (int)thread::hardware_concurrency());
+  }
+}
+
+Server::~Server() {
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    threads_[i].join();
+  }
+}
+
+bool Server::run(int port) {
+  return runShard(0, port);
+}
+
+bool Server::runShard(int index, int port) {
+  // the hub and its loop belong to this thread
+  uWS::Hub h;
+  const RoadMap &road_map = road_map_;
+  ThreadPool &pool = pool_;
+
+  h.onMessage([](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length,
+                 uWS::OpCode opCode) {
+    PlannerSession *session = PlannerSession::of(ws);
+    if (session) {
+      session->onMessage(data, length);
+    }
+  });
+
+  // Latency per stage over all sessions of the process: /latency as JSON,
+  // /metrics in the Prometheus text format
+  h.onHttpRequest([this](uWS::HttpResponse *res, uWS::HttpRequest req,
+                         char *data, size_t, size_t) {
+    uWS::Header url = req.getUrl();
+    string path(url.value, url.valueLength);
+    if (path == "/latency") {
+      string s = stats_.json();
+      res->end(s.data(), s.length());
+    } else if (path == "/metrics") {
+      string s = stats_.prometheus();
+      res->end(s.data(), s.length());
+    } else if (url.valueLength == 1) {
+      const std::string s = "<h1>Hello world!</h1>";
+      res->end(s.data(), s.length());
+    } else {
+      // i guess this should be done more gracefully?
+      res->end(nullptr, 0);
+    }
+  });
+
+  h.onConnection([this, &h, &road_map, &pool](uWS::WebSocket<uWS::SERVER> ws,
+                                              uWS::HttpRequest req) {
+    int n = num_sessions_++;
+    string log_path;
+    if (!log_prefix_.empty()) {
+      log_path = log_prefix_ + "-" + to_string(n) + ".log";
+    }
+    // attaches itself to ws
+    new PlannerSession(h.getLoop(), road_map, pool, ws, &stats_, log_path);
+    std::cout << "Connected!!!" << std::endl;
+  });
+
+  h.onDisconnection([&h](uWS::WebSocket<uWS::SERVER> ws, int code,
+                         char *message, size_t length) {
+    PlannerSession *session = PlannerSession::of(ws);
+    if (session) {
+      session->close();
+    }
+    ws.close();
+    std::cout << "Disconnected" << std::endl;
+  });
+
+  if (!h.listen(port, nullptr, uS::ListenOptions::REUSE_PORT)) {
+    std::cerr << "Shard " << index << " failed to listen to port" << std::endl;
+    return false;
+  }
+  if (index == 0) {
+    // the port is ours, start the other shards on it
+    for (int i = 1; i < num_shards_; ++i) {
+      threads_.push_back(thread(&Server::runShard, this, i, port));
+    }
+    std::cout << "Listening to port " << port << " with " << num_shards_
+              << " shards" << std::endl;
+  }
+  h.run();
+  return true;
+}
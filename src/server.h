@@ -0,0 +1,48 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latency_stats.h"
+#include "road_map.h"
+#include "thread_pool.h"
+
+// Websocket server for the simulators, spread over several event loops.
+//
+// Every shard is a uWS hub with its own loop and thread, all listening on
+// the same port with SO_REUSEPORT so the kernel balances new connections
+// across them. A connection and its planner session stay on the shard
+// that accepted it. The road map is only read and the worker pool takes
+// jobs from any thread, so both are shared.
+class Server {
+ public:
+  // 0 shards means one per hardware thread. With a log prefix every
+  // session is recorded to <log_prefix>-<n>.log, n counting connections.
+  Server(const RoadMap &road_map, ThreadPool &pool, int num_shards = 0,
+         const std::string &log_prefix = "");
+  ~Server();
+
+  int size() const { return num_shards_; }
+
+  // Serves port until the process ends. The first shard runs on the
+  // calling thread and starts the others once it listens, returns false
+  // if it can't.
+  bool run(int port);
+
+ private:
+  bool runShard(int index, int port);
+
+  const RoadMap &road_map_;
+  ThreadPool &pool_;
+  int num_shards_;
+  std::string log_prefix_;
+  std::atomic<int> num_sessions_;
+  // shared by the sessions of all shards
+  LatencyStats stats_;
+  std::vector<std::thread> threads_;
+};
+
+#endif /* SERVER_H */
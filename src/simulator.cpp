@@ -0,0 +1,392 @@
+#include "simulator.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "control_message.h"
+#include "traffic.h"
+
+using namespace std;
+
+namespace {
+
+// the simulator drives one path point per tick
+const double kDt = 0.02;
+const double kMphToMs = 0.44704;
+
+// where the Udacity simulator puts the ego car
+const double kStartS = 124.8336;
+const double kStartD = 6.1648;
+
+// spawn ranges around the ego car, cars outside of [kDropBehind,
+// kDropAhead] are spawned again
+const double kSpawnBehind = -80.0;
+const double kSpawnAhead = 350.0;
+const double kDropBehind = -150.0;
+const double kDropAhead = 400.0;
+
+// traffic behavior
+const double kLookAhead = 60.0;        // m, leaders further away are ignored
+const double kMinGap = 10.0;           // m, gap kept when standing
+const double kHeadway = 2.0;           // s, gap kept per m/s of speed
+const double kTrafficAcc = 3.0;        // m/s^2
+const double kTrafficDec = 8.0;        // m/s^2
+const double kLaneChangeSpeed = 1.5;   // m/s towards the new lane center
+// two vehicles are in the same lane when their centers are this close in d
+const double kSameLane = 2.5;
+
+// contact between the ego car and another vehicle
+const double kCarLength = 4.5;
+const double kCarWidth = 2.0;
+
+// comfort limits and the window they are measured over (0.2 s)
+const double kMaxAcc = 10.0;
+const double kMaxJerk = 50.0;
+const int kWindow = 10;
+const int kHistory = 2 * kWindow + 1;
+
+double laneCenter(int lane) {
+  return kLaneWidth * (lane + 0.5);
+}
+
+void appendNumber(string &out, double v) {
+  char buf[kMaxDoubleChars];
+  out.append(buf, formatDouble(v, buf));
+}
+
+void appendArray(string &out, const double *v, size_t n) {
+  out += '[';
+  for (size_t i = 0; i < n; ++i) {
+    if (i) {
+      out += ',';
+    }
+    appendNumber(out, v[i]);
+  }
+  out += ']';
+}
+
+// reads the number array following "key": in text
+bool readArray(const string &text, const char *key, vector<double> &values) {
+  size_t pos = text.find(key);
+  if (pos == string::npos) {
+    return false;
+  }
+  pos = text.find('[', pos);
+  if (pos == string::npos) {
+    return false;
+  }
+  const char *p = text.c_str() + pos + 1;
+  values.clear();
+  while (true) {
+    while (*p == ' ' || *p == ',') {
+      ++p;
+    }
+    if (*p == ']') {
+      return true;
+    }
+    char *end;
+    double v = strtod(p, &end);
+    if (end == p) {
+      return false;
+    }
+    values.push_back(v);
+    p = end;
+  }
+}
+
+}  // namespace
+
+Simulator::Simulator(const RoadMap &road_map, const SimulatorConfig &config)
+    : road_map_(road_map), config_(config), rng_(config.seed), next_id_(0),
+      s_(kStartS), d_(kStartD), speed_(0.0), path_pos_(0),
+      end_path_s_(0.0), end_path_d_(0.0), hist_x_(kHistory),
+      hist_y_(kHistory), hist_ax_(kHistory), hist_ay_(kHistory),
+      samples_(0), acc_violation_(false), jerk_violation_(false),
+      speeding_(false), off_road_(false), cars_(config.num_cars) {
+  road_map_.getXY(s_, d_, x_, y_);
+  double x1, y1;
+  road_map_.getXY(s_ + 1.0, d_, x1, y1);
+  yaw_ = atan2(y1 - y_, x1 - x_);
+
+  for (size_t i = 0; i < cars_.size(); ++i) {
+    cars_[i].s = s_;
+    // off the road until placed
+    cars_[i].d = cars_[i].target_d = -kLaneWidth;
+  }
+  for (size_t i = 0; i < cars_.size(); ++i) {
+    spawnCar(cars_[i], kSpawnBehind, kSpawnAhead);
+  }
+}
+
+void Simulator::telemetry(string &message) const {
+  message.clear();
+  message += "42[\"telemetry\",{\"x\":";
+  appendNumber(message, x_);
+  message += ",\"y\":";
+  appendNumber(message, y_);
+  message += ",\"yaw\":";
+  appendNumber(message, yaw_ * 180.0 / M_PI);
+  message += ",\"speed\":";
+  appendNumber(message, speed_ / kMphToMs);
+  message += ",\"s\":";
+  appendNumber(message, s_);
+  message += ",\"d\":";
+  appendNumber(message, d_);
+
+  size_t left = path_x_.size() - path_pos_;
+  message += ",\"previous_path_x\":";
+  appendArray(message, left ? &path_x_[path_pos_] : NULL, left);
+  message += ",\"previous_path_y\":";
+  appendArray(message, left ? &path_y_[path_pos_] : NULL, left);
+  message += ",\"end_path_s\":";
+  appendNumber(message, end_path_s_);
+  message += ",\"end_path_d\":";
+  appendNumber(message, end_path_d_);
+
+  message += ",\"sensor_fusion\":[";
+  for (size_t i = 0; i < cars_.size(); ++i) {
+    const Car &car = cars_[i];
+    double row[7] = {(double)car.id, car.x, car.y, car.vx, car.vy, car.s,
+                     car.d};
+    if (i) {
+      message += ',';
+    }
+    appendArray(message, row, 7);
+  }
+  message += "]}]";
+}
+
+bool Simulator::control(const char *data, size_t length) {
+  string text(data, length);
+  vector<double> next_x, next_y;
+  bool ok = readArray(text, "\"next_x\"", next_x) &&
+            readArray(text, "\"next_y\"", next_y) &&
+            next_x.size() == next_y.size();
+  if (ok) {
+    path_x_.swap(next_x);
+    path_y_.swap(next_y);
+    path_pos_ = 0;
+  }
+
+  for (int i = 0; i < config_.points_per_cycle; ++i) {
+    step();
+  }
+  if (path_pos_ < path_x_.size()) {
+    road_map_.getFrenet(path_x_.back(), path_y_.back(), end_path_s_,
+                        end_path_d_);
+  } else {
+    end_path_s_ = end_path_d_ = 0.0;
+  }
+  ++stats_.cycles;
+  return ok;
+}
+
+void Simulator::step() {
+  if (path_pos_ < path_x_.size()) {
+    double x = path_x_[path_pos_];
+    double y = path_y_[path_pos_];
+    ++path_pos_;
+    double dist = sqrt((x - x_) * (x - x_) + (y - y_) * (y - y_));
+    if (dist > 1e-6) {
+      yaw_ = atan2(y - y_, x - x_);
+    }
+    speed_ = dist / kDt;
+    stats_.distance += dist;
+    x_ = x;
+    y_ = y;
+  } else {
+    // out of path, the car stops where it is
+    speed_ = 0.0;
+  }
+  road_map_.getFrenet(x_, y_, s_, d_);
+
+  for (size_t i = 0; i < cars_.size(); ++i) {
+    moveCar(cars_[i], s_, d_);
+    double ds = deltaS(s_, cars_[i].s);
+    if (ds < kDropBehind) {
+      spawnCar(cars_[i], kSpawnAhead - 100.0, kSpawnAhead);
+    } else if (ds > kDropAhead) {
+      spawnCar(cars_[i], kSpawnBehind - 50.0, kSpawnBehind);
+    }
+  }
+  stats_.time += kDt;
+  checkEgo();
+}
+
+void Simulator::moveCar(Car &car, double ego_s, double ego_d) {
+  // closest vehicle ahead in the lane, the ego car included
+  double gap = kLookAhead;
+  double leader_speed = car.target_speed;
+  for (size_t i = 0; i < cars_.size(); ++i) {
+    const Car &other = cars_[i];
+    double ds = deltaS(car.s, other.s);
+    if (&other != &car && fabs(other.d - car.d) < kSameLane && ds > 0.0 &&
+        ds < gap) {
+      gap = ds;
+      leader_speed = other.speed;
+    }
+  }
+  double ds = deltaS(car.s, ego_s);
+  if (fabs(ego_d - car.d) < kSameLane && ds > 0.0 && ds < gap) {
+    gap = ds;
+    leader_speed = speed_;
+  }
+
+  // slow down towards the leader's speed, more the closer it gets
+  double want = car.target_speed;
+  double safe_gap = kMinGap + kHeadway * car.speed;
+  if (gap < safe_gap) {
+    want = min(want, leader_speed * max(0.0, gap - kCarLength) / safe_gap);
+  }
+  if (want > car.speed) {
+    car.speed = min(want, car.speed + kTrafficAcc * kDt);
+  } else {
+    car.speed = max(want, car.speed - kTrafficDec * kDt);
+  }
+
+  // blocked cars look for a way around now and then
+  bool changing = fabs(car.d - car.target_d) > 0.1;
+  uniform_real_distribution<double> chance(0.0, 1.0);
+  if (!changing && gap < 2.0 * safe_gap &&
+      leader_speed < car.target_speed - 1.0 &&
+      chance(rng_) < config_.lane_change_rate * kDt) {
+    int lane = (int)(car.target_d / kLaneWidth);
+    int side = chance(rng_) < 0.5 ? -1 : 1;
+    for (int k = 0; k < 2; ++k, side = -side) {
+      int target = lane + side;
+      if (target >= 0 && target < kNumLanes &&
+          laneFree(target, car.s, 15.0, 25.0, &car, ego_s, ego_d)) {
+        car.target_d = laneCenter(target);
+        break;
+      }
+    }
+  }
+  // a lane change that runs into someone is called off
+  if (changing) {
+    int target = (int)(car.target_d / kLaneWidth);
+    if (!laneFree(target, car.s, kCarLength * 2.0, kCarLength * 2.0, &car,
+                  ego_s, ego_d)) {
+      car.target_d = laneCenter(car.d < car.target_d ? target - 1 : target + 1);
+    }
+  }
+  double dd = car.target_d - car.d;
+  car.d += max(-kLaneChangeSpeed * kDt, min(kLaneChangeSpeed * kDt, dd));
+
+  car.s = fmod(car.s + car.speed * kDt, road_map_.max_s());
+  double x = car.x;
+  double y = car.y;
+  road_map_.getXY(car.s, car.d, car.x, car.y);
+  car.vx = (car.x - x) / kDt;
+  car.vy = (car.y - y) / kDt;
+}
+
+void Simulator::spawnCar(Car &car, double ahead_min, double ahead_max) {
+  uniform_real_distribution<double> offset(ahead_min, ahead_max);
+  uniform_int_distribution<int> lanes(0, kNumLanes - 1);
+  uniform_real_distribution<double> spread(-config_.speed_spread,
+                                           config_.speed_spread);
+  // keep some room to the other cars if there is any, and enough to the
+  // ego car that nobody has to brake hard right away
+  int lane = 0;
+  double s = s_;
+  for (int attempt = 0; attempt < 20; ++attempt) {
+    lane = lanes(rng_);
+    double ds = offset(rng_);
+    s = s_ + ds;
+    if (laneFree(lane, s, 20.0, 20.0, &car, s_, d_) &&
+        (fabs(ds) > kLookAhead || fabs(d_ - laneCenter(lane)) >= kSameLane)) {
+      break;
+    }
+  }
+
+  car.id = next_id_++;
+  car.s = fmod(s + road_map_.max_s(), road_map_.max_s());
+  car.d = car.target_d = laneCenter(lane);
+  car.target_speed = (config_.speed_limit + spread(rng_)) * kMphToMs;
+  car.speed = car.target_speed;
+  car.contact = false;
+  road_map_.getXY(car.s, car.d, car.x, car.y);
+  double x1, y1;
+  road_map_.getXY(car.s + 1.0, car.d, x1, y1);
+  double len = sqrt((x1 - car.x) * (x1 - car.x) + (y1 - car.y) * (y1 - car.y));
+  car.vx = car.speed * (x1 - car.x) / len;
+  car.vy = car.speed * (y1 - car.y) / len;
+}
+
+double Simulator::deltaS(double s0, double s1) const {
+  double max_s = road_map_.max_s();
+  double ds = fmod(s1 - s0, max_s);
+  if (ds >= 0.5 * max_s) {
+    ds -= max_s;
+  } else if (ds < -0.5 * max_s) {
+    ds += max_s;
+  }
+  return ds;
+}
+
+bool Simulator::laneFree(int lane, double s, double behind, double ahead,
+                         const Car *skip, double ego_s, double ego_d) const {
+  double center = laneCenter(lane);
+  for (size_t i = 0; i < cars_.size(); ++i) {
+    const Car &other = cars_[i];
+    if (&other == skip) {
+      continue;
+    }
+    if (fabs(other.d - center) < kSameLane ||
+        fabs(other.target_d - center) < kSameLane) {
+      double ds = deltaS(s, other.s);
+      if (ds > -behind && ds < ahead) {
+        return false;
+      }
+    }
+  }
+  double ds = deltaS(s, ego_s);
+  return !(fabs(ego_d - center) < kSameLane && ds > -behind && ds < ahead);
+}
+
+void Simulator::checkEgo() {
+  // acceleration over the last two 0.2 s windows, jerk from the
+  // accelerations 0.2 s apart
+  int n = samples_ % kHistory;
+  hist_x_[n] = x_;
+  hist_y_[n] = y_;
+  ++samples_;
+  if (samples_ >= kHistory) {
+    int m = (n + kHistory - kWindow) % kHistory;
+    int o = (n + 1) % kHistory;
+    const double w = kWindow * kDt;
+    double ax = ((hist_x_[n] - hist_x_[m]) - (hist_x_[m] - hist_x_[o])) / (w * w);
+    double ay = ((hist_y_[n] - hist_y_[m]) - (hist_y_[m] - hist_y_[o])) / (w * w);
+    hist_ax_[n] = ax;
+    hist_ay_[n] = ay;
+
+    bool acc = sqrt(ax * ax + ay * ay) > kMaxAcc;
+    stats_.acc_violations += acc && !acc_violation_;
+    acc_violation_ = acc;
+    if (samples_ >= kHistory + kWindow) {
+      double jx = (ax - hist_ax_[m]) / w;
+      double jy = (ay - hist_ay_[m]) / w;
+      bool jerk = sqrt(jx * jx + jy * jy) > kMaxJerk;
+      stats_.jerk_violations += jerk && !jerk_violation_;
+      jerk_violation_ = jerk;
+    }
+  }
+
+  bool speeding = speed_ > config_.speed_limit * kMphToMs;
+  stats_.speeding += speeding && !speeding_;
+  speeding_ = speeding;
+
+  bool off_road = d_ < 0.0 || d_ > kNumLanes * kLaneWidth;
+  stats_.off_road += off_road && !off_road_;
+  off_road_ = off_road;
+
+  for (size_t i = 0; i < cars_.size(); ++i) {
+    Car &car = cars_[i];
+    bool contact = fabs(deltaS(s_, car.s)) < kCarLength &&
+                   fabs(car.d - d_) < kCarWidth;
+    stats_.collisions += contact && !car.contact;
+    car.contact = contact;
+  }
+}
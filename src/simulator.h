@@ -0,0 +1,125 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stddef.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "road_map.h"
+
+struct SimulatorConfig {
+  SimulatorConfig()
+      : num_cars(12), speed_limit(50.0), speed_spread(10.0),
+        points_per_cycle(3), lane_change_rate(0.05), seed(1) {}
+
+  int num_cars;
+  // traffic drives at speed_limit +- speed_spread, in MPH
+  double speed_limit;
+  double speed_spread;
+  // path points the ego car drives between two telemetry messages
+  int points_per_cycle;
+  // lane changes per second a blocked car starts
+  double lane_change_rate;
+  unsigned seed;
+};
+
+// Incidents are counted once when they start, not for every point
+struct SimulatorStats {
+  SimulatorStats()
+      : time(0.0), distance(0.0), cycles(0), collisions(0),
+        acc_violations(0), jerk_violations(0), speeding(0), off_road(0) {}
+
+  double time;      // simulated seconds
+  double distance;  // meters driven by the ego car
+  long cycles;      // telemetry/control round trips
+  int collisions;
+  int acc_violations;   // total acceleration over 10 m/s^2
+  int jerk_violations;  // jerk over 50 m/s^3
+  int speeding;         // faster than the speed limit
+  int off_road;         // ego car center outside the three lanes
+};
+
+// Headless stand-in for the Udacity simulator.
+//
+// Speaks the same protocol in process: telemetry() writes the message the
+// simulator would send, control() takes the planner's reply. The ego car
+// drives exactly along the path points, one every 0.02 s, and
+// points_per_cycle of them are consumed per round trip, the rest come
+// back as the previous path. Traffic keeps to its lane at its own speed,
+// follows slower cars and now and then changes lanes to pass them. Cars
+// that fall too far behind or get too far ahead are respawned around the
+// ego car, so the traffic density stays the same on long runs.
+class Simulator {
+ public:
+  Simulator(const RoadMap &road_map, const SimulatorConfig &config);
+
+  // 42["telemetry",{...}] for the current state
+  void telemetry(std::string &message) const;
+  // Takes a 42["control",{...}] message as the new path and drives one
+  // cycle along it. False if the message can't be read, the cycle is
+  // driven on the old path then.
+  bool control(const char *data, size_t length);
+
+  const SimulatorStats &stats() const { return stats_; }
+
+ private:
+  struct Car {
+    int id;
+    double s;
+    double d;
+    double speed;         // m/s along the lane
+    double target_speed;
+    double target_d;      // lane center it is heading for
+    double x;
+    double y;
+    double vx;
+    double vy;
+    bool contact;         // touching the ego car
+  };
+
+  void step();
+  void moveCar(Car &car, double ego_s, double ego_d);
+  // places car at a random free spot ahead_min..ahead_max from the ego car
+  void spawnCar(Car &car, double ahead_min, double ahead_max);
+  // distance from s0 forward to s1 around the loop, in [-max_s/2, max_s/2)
+  double deltaS(double s0, double s1) const;
+  bool laneFree(int lane, double s, double behind, double ahead,
+                const Car *skip, double ego_s, double ego_d) const;
+  void checkEgo();
+
+  const RoadMap &road_map_;
+  SimulatorConfig config_;
+  std::mt19937 rng_;
+  int next_id_;
+
+  // ego car, speed in m/s and yaw in radians
+  double x_;
+  double y_;
+  double s_;
+  double d_;
+  double yaw_;
+  double speed_;
+  // path points not driven yet
+  std::vector<double> path_x_;
+  std::vector<double> path_y_;
+  size_t path_pos_;
+  double end_path_s_;
+  double end_path_d_;
+  // last positions and accelerations for the comfort checks
+  std::vector<double> hist_x_;
+  std::vector<double> hist_y_;
+  std::vector<double> hist_ax_;
+  std::vector<double> hist_ay_;
+  int samples_;
+  bool acc_violation_;
+  bool jerk_violation_;
+  bool speeding_;
+  bool off_road_;
+
+  std::vector<Car> cars_;
+  SimulatorStats stats_;
+};
+
+#endif /* SIMULATOR_H */
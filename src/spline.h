@@ -29,6 +29,8 @@
 
 #include <cstdio>
 #include <cassert>
+#include <cmath>
+#include <array>
 #include <vector>
 #include <algorithm>
 
@@ -41,38 +43,75 @@ namespace
 namespace tk
 {
 
-// band matrix solver
-class band_matrix
+// storage for a tridiagonal matrix, solved by tridiagonal_solve()
+// the three bands live in one flat array, so once sized the matrix can
+// be refilled and solved without allocating
+class tridiagonal_matrix
 {
 private:
-    std::vector< std::vector<double> > m_upper;  // upper band
-    std::vector< std::vector<double> > m_lower;  // lower band
+    std::vector<double> m_bands;    // lower | diagonal | upper, dim each
+    int m_dim;
 public:
-    band_matrix() {};                             // constructor
-    band_matrix(int dim, int n_u, int n_l);       // constructor
-    ~band_matrix() {};                            // destructor
-    void resize(int dim, int n_u, int n_l);      // init with dim,n_u,n_l
-    int dim() const;                             // matrix dimension
-    int num_upper() const
+    tridiagonal_matrix(): m_dim(0) {};            // constructor
+    ~tridiagonal_matrix() {};                     // destructor
+    void resize(int dim);                         // keeps capacity
+    int dim() const
     {
-        return m_upper.size()-1;
+        return m_dim;
     }
-    int num_lower() const
+    // bands, lower()[i]=A(i,i-1), diag()[i]=A(i,i), upper()[i]=A(i,i+1)
+    double* lower()
     {
-        return m_lower.size()-1;
-    }
-    // access operator
-    double & operator () (int i, int j);            // write
-    double   operator () (int i, int j) const;      // read
-    // we can store an additional diogonal (in m_lower)
-    double& saved_diag(int i);
-    double  saved_diag(int i) const;
-    void lu_decompose();
-    std::vector<double> r_solve(const std::vector<double>& b) const;
-    std::vector<double> l_solve(const std::vector<double>& b) const;
-    std::vector<double> lu_solve(const std::vector<double>& b,
-                                 bool is_lu_decomposed=false);
+        return &m_bands[0];
+    }
+    double* diag()
+    {
+        return &m_bands[m_dim];
+    }
+    double* upper()
+    {
+        return &m_bands[2*m_dim];
+    }
+};
+
+// solves the tridiagonal system in place: lower[i]=A(i,i-1),
+// diag[i]=A(i,i), upper[i]=A(i,i+1); diag and b are overwritten,
+// the solution is returned in b
+void tridiagonal_solve(int n, const double* lower, double* diag,
+                       const double* upper, double* b);
 
+
+// read-only view on the points and coefficients of a spline, the
+// evaluation code is shared by spline and static_spline through it
+struct spline_view
+{
+    int n;
+    const double *x, *y;                    // points
+    const double *a, *b, *c;                // coefficients
+    double b0, c0;                          // for left extrapol
+    double operator() (double x) const;
+    // order-th derivative at x, order=1,2,3
+    double deriv(int order, double x) const;
+    // y[i]=f(x[i]) for n arbitrary x
+    void eval_batch(const double* xs, double* ys, size_t m) const;
+    // same for ascending xs: walks the segments forward instead of
+    // searching, each run of samples in a segment is a plain Horner loop
+    void eval_batch_sorted(const double* xs, double* ys, size_t m) const;
+    // batched derivatives, same as above
+    void deriv_batch(int order, const double* xs, double* ys,
+                     size_t m) const;
+    void deriv_batch_sorted(int order, const double* xs, double* ys,
+                            size_t m) const;
+
+    // piece of the spline used at xq: -1 left extrapolation, n-1 right
+    // extrapolation, otherwise the segment with x[idx] < xq <= x[idx+1]
+    int piece(double xq) const;
+    // f(x) = ((pa*h + pb)*h + pc)*h + y0 with h=x-x0 on that piece
+    void piece_coeffs(int idx, double& x0, double& y0,
+                      double& pa, double& pb, double& pc) const;
+    // calls f(h,pa,pb,pc,y0) for every xs, walking the pieces forward
+    template<class F>
+    void eval_runs(const double* xs, double* ys, size_t m, F f) const;
 };
 
 
@@ -94,6 +133,7 @@ private:
     bd_type m_left, m_right;
     double  m_left_value, m_right_value;
     bool    m_force_linear_extrapolation;
+    tridiagonal_matrix m_sys;               // reused for every set_points()
 
 public:
     // set default boundary condition to be zero curvature at both ends
@@ -111,160 +151,182 @@ public:
     void set_points(const std::vector<double>& x,
                     const std::vector<double>& y, bool cubic_spline=true);
     double operator() (double x) const;
+    void eval_batch(const double* x, double* y, size_t n) const
+    {
+        view().eval_batch(x,y,n);
+    }
+    void eval_batch_sorted(const double* x, double* y, size_t n) const
+    {
+        view().eval_batch_sorted(x,y,n);
+    }
+    double deriv(int order, double x) const
+    {
+        return view().deriv(order,x);
+    }
+    void deriv_batch(int order, const double* x, double* y, size_t n) const
+    {
+        view().deriv_batch(order,x,y,n);
+    }
+    void deriv_batch_sorted(int order, const double* x, double* y,
+                            size_t n) const
+    {
+        view().deriv_batch_sorted(order,x,y,n);
+    }
+    spline_view view() const;
 };
 
 
+// computes the coefficients of a spline through the n points x,y into
+// a,b,c (and b0,c0 for the left extrapolation); lower, diag and upper are
+// scratch space of size n for the equation system
+void spline_coefficients(int n, const double* x, const double* y,
+                         bool cubic_spline,
+                         spline::bd_type left, double left_value,
+                         spline::bd_type right, double right_value,
+                         bool force_linear_extrapolation,
+                         double* a, double* b, double* c,
+                         double& b0, double& c0,
+                         double* lower, double* diag, double* upper);
 
-// ---------------------------------------------------------------------
-// implementation part, which could be separated into a cpp file
-// ---------------------------------------------------------------------
 
+// spline with storage for up to N points inline in the object, so it can
+// be refit and evaluated without ever touching the heap
+template<int N>
+class static_spline
+{
+public:
+    typedef spline::bd_type bd_type;
 
-// band_matrix implementation
-// -------------------------
+private:
+    // structure of arrays, same meaning as in spline
+    std::array<double,N> m_x,m_y;
+    std::array<double,N> m_a,m_b,m_c;
+    std::array<double,N> m_lower,m_diag,m_upper;    // equation system
+    int     m_n;
+    double  m_b0, m_c0;
+    bd_type m_left, m_right;
+    double  m_left_value, m_right_value;
+    bool    m_force_linear_extrapolation;
 
-band_matrix::band_matrix(int dim, int n_u, int n_l)
-{
-    resize(dim, n_u, n_l);
-}
-void band_matrix::resize(int dim, int n_u, int n_l)
-{
-    assert(dim>0);
-    assert(n_u>=0);
-    assert(n_l>=0);
-    m_upper.resize(n_u+1);
-    m_lower.resize(n_l+1);
-    for(size_t i=0; i<m_upper.size(); i++) {
-        m_upper[i].resize(dim);
+public:
+    // set default boundary condition to be zero curvature at both ends
+    static_spline(): m_n(0), m_b0(0.0), m_c0(0.0),
+        m_left(spline::second_deriv), m_right(spline::second_deriv),
+        m_left_value(0.0), m_right_value(0.0),
+        m_force_linear_extrapolation(false)
+    {
+        ;
     }
-    for(size_t i=0; i<m_lower.size(); i++) {
-        m_lower[i].resize(dim);
+
+    // optional, takes effect with the next set_points()
+    void set_boundary(bd_type left, double left_value,
+                      bd_type right, double right_value,
+                      bool force_linear_extrapolation=false);
+    // 3 <= n <= N, may be called repeatedly to refit in place
+    void set_points(const double* x, const double* y, int n,
+                    bool cubic_spline=true);
+    double operator() (double x) const;
+    void eval_batch(const double* x, double* y, size_t n) const
+    {
+        view().eval_batch(x,y,n);
     }
-}
-int band_matrix::dim() const
-{
-    if(m_upper.size()>0) {
-        return m_upper[0].size();
-    } else {
-        return 0;
+    void eval_batch_sorted(const double* x, double* y, size_t n) const
+    {
+        view().eval_batch_sorted(x,y,n);
     }
-}
+    double deriv(int order, double x) const
+    {
+        return view().deriv(order,x);
+    }
+    void deriv_batch(int order, const double* x, double* y, size_t n) const
+    {
+        view().deriv_batch(order,x,y,n);
+    }
+    void deriv_batch_sorted(int order, const double* x, double* y,
+                            size_t n) const
+    {
+        view().deriv_batch_sorted(order,x,y,n);
+    }
+    spline_view view() const;
+    int size() const
+    {
+        return m_n;
+    }
+};
 
 
-// defines the new operator (), so that we can access the elements
-// by A(i,j), index going from i=0,...,dim()-1
-double & band_matrix::operator () (int i, int j)
-{
-    int k=j-i;       // what band is the entry
-    assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
-    assert( (-num_lower()<=k) && (k<=num_upper()) );
-    // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
-    if(k>=0)   return m_upper[k][i];
-    else	    return m_lower[-k][i];
-}
-double band_matrix::operator () (int i, int j) const
-{
-    int k=j-i;       // what band is the entry
-    assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
-    assert( (-num_lower()<=k) && (k<=num_upper()) );
-    // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
-    if(k>=0)   return m_upper[k][i];
-    else	    return m_lower[-k][i];
-}
-// second diag (used in LU decomposition), saved in m_lower
-double band_matrix::saved_diag(int i) const
-{
-    assert( (i>=0) && (i<dim()) );
-    return m_lower[0][i];
-}
-double & band_matrix::saved_diag(int i)
+// arc length parameterization of a spline y(x), to place points at exact
+// distances along the curve instead of at even steps in x. The cumulative
+// length at the knots comes from 5 point Gauss-Legendre quadrature per
+// segment, the x for a given length from a few Newton steps inside the
+// segment. Holds up to N knots inline; it keeps pointers into the spline,
+// which must not be refit or destroyed while the sampler is in use.
+template<int N>
+class arc_length_sampler
 {
-    assert( (i>=0) && (i<dim()) );
-    return m_lower[0][i];
-}
+private:
+    spline_view m_spline;
+    std::array<double,N> m_len;     // arc length from x[0] to knot i
 
-// LR-Decomposition of a band matrix
-void band_matrix::lu_decompose()
-{
-    int  i_max,j_max;
-    int  j_min;
-    double x;
+    // arc length from x_a to x_b on piece idx
+    double piece_length(int idx, double x_a, double x_b) const;
 
-    // preconditioning
-    // normalize column i so that a_ii=1
-    for(int i=0; i<this->dim(); i++) {
-        assert(this->operator()(i,i)!=0.0);
-        this->saved_diag(i)=1.0/this->operator()(i,i);
-        j_min=std::max(0,i-this->num_lower());
-        j_max=std::min(this->dim()-1,i+this->num_upper());
-        for(int j=j_min; j<=j_max; j++) {
-            this->operator()(i,j) *= this->saved_diag(i);
-        }
-        this->operator()(i,i)=1.0;          // prevents rounding errors
-    }
-
-    // Gauss LR-Decomposition
-    for(int k=0; k<this->dim(); k++) {
-        i_max=std::min(this->dim()-1,k+this->num_lower());  // num_lower not a mistake!
-        for(int i=k+1; i<=i_max; i++) {
-            assert(this->operator()(k,k)!=0.0);
-            x=-this->operator()(i,k)/this->operator()(k,k);
-            this->operator()(i,k)=-x;                         // assembly part of L
-            j_max=std::min(this->dim()-1,k+this->num_upper());
-            for(int j=k+1; j<=j_max; j++) {
-                // assembly part of R
-                this->operator()(i,j)=this->operator()(i,j)+x*this->operator()(k,j);
-            }
-        }
-    }
-}
-// solves Ly=b
-std::vector<double> band_matrix::l_solve(const std::vector<double>& b) const
-{
-    assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
-    int j_start;
-    double sum;
-    for(int i=0; i<this->dim(); i++) {
-        sum=0;
-        j_start=std::max(0,i-this->num_lower());
-        for(int j=j_start; j<i; j++) sum += this->operator()(i,j)*x[j];
-        x[i]=(b[i]*this->saved_diag(i)) - sum;
-    }
-    return x;
-}
-// solves Rx=y
-std::vector<double> band_matrix::r_solve(const std::vector<double>& b) const
-{
-    assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
-    int j_stop;
-    double sum;
-    for(int i=this->dim()-1; i>=0; i--) {
-        sum=0;
-        j_stop=std::min(this->dim()-1,i+this->num_upper());
-        for(int j=i+1; j<=j_stop; j++) sum += this->operator()(i,j)*x[j];
-        x[i]=( b[i] - sum ) / this->operator()(i,i);
+public:
+    arc_length_sampler()
+    {
+        m_spline.n=0;
     }
-    return x;
+    void build(const spline_view& s);
+    // arc length from the first knot to x (x >= first knot)
+    double length_at(double x) const;
+    // x at arc length len from the first knot
+    double x_at(double len) const;
+    // starting at x_start emits m points, point k at arc length
+    // ds[0]+...+ds[k] from x_start (ds e.g. v_k*dt of a velocity profile)
+    void sample(double x_start, const double* ds, size_t m,
+                double* xs, double* ys) const;
+    // same with a constant spacing ds
+    void sample(double x_start, double ds, size_t m,
+                double* xs, double* ys) const;
+};
+
+
+
+// ---------------------------------------------------------------------
+// implementation part, which could be separated into a cpp file
+// ---------------------------------------------------------------------
+
+
+// tridiagonal_matrix implementation
+// ---------------------------------
+
+void tridiagonal_matrix::resize(int dim)
+{
+    assert(dim>0);
+    m_bands.resize(3*dim);
+    m_dim=dim;
 }
 
-std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
-        bool is_lu_decomposed)
+void tridiagonal_solve(int n, const double* lower, double* diag,
+                       const double* upper, double* b)
 {
-    assert( this->dim()==(int)b.size() );
-    std::vector<double>  x,y;
-    if(is_lu_decomposed==false) {
-        this->lu_decompose();
+    // forward elimination
+    for(int i=1; i<n; i++) {
+        assert(diag[i-1]!=0.0);
+        double w=lower[i]/diag[i-1];
+        diag[i] -= w*upper[i-1];
+        b[i] -= w*b[i-1];
+    }
+    // back substitution
+    assert(diag[n-1]!=0.0);
+    b[n-1] /= diag[n-1];
+    for(int i=n-2; i>=0; i--) {
+        b[i]=(b[i]-upper[i]*b[i+1])/diag[i];
     }
-    y=this->l_solve(b);
-    x=this->r_solve(y);
-    return x;
 }
 
 
 
-
 // spline implementation
 // -----------------------
 
@@ -286,113 +348,433 @@ void spline::set_points(const std::vector<double>& x,
 {
     assert(x.size()==y.size());
     assert(x.size()>2);
+    // assignments and resizes keep the capacity, so refitting with no more
+    // points than before does not allocate
     m_x=x;
     m_y=y;
     int   n=x.size();
+    m_a.resize(n);
+    m_b.resize(n);
+    m_c.resize(n);
+    m_sys.resize(n);
+    spline_coefficients(n, &m_x[0], &m_y[0], cubic_spline,
+                        m_left, m_left_value, m_right, m_right_value,
+                        m_force_linear_extrapolation,
+                        &m_a[0], &m_b[0], &m_c[0], m_b0, m_c0,
+                        m_sys.lower(), m_sys.diag(), m_sys.upper());
+}
+
+double spline::operator() (double x) const
+{
+    return view()(x);
+}
+
+spline_view spline::view() const
+{
+    spline_view v;
+    v.n=m_x.size();
+    v.x=m_x.data();
+    v.y=m_y.data();
+    v.a=m_a.data();
+    v.b=m_b.data();
+    v.c=m_c.data();
+    v.b0=m_b0;
+    v.c0=m_c0;
+    return v;
+}
+
+
+void spline_coefficients(int n, const double* x, const double* y,
+                         bool cubic_spline,
+                         spline::bd_type left, double left_value,
+                         spline::bd_type right, double right_value,
+                         bool force_linear_extrapolation,
+                         double* a, double* b, double* c,
+                         double& b0, double& c0,
+                         double* lower, double* diag, double* upper)
+{
     // TODO: maybe sort x and y, rather than returning an error
     for(int i=0; i<n-1; i++) {
-        assert(m_x[i]<m_x[i+1]);
+        assert(x[i]<x[i+1]);
     }
 
     if(cubic_spline==true) { // cubic spline interpolation
-        // setting up the matrix and right hand side of the equation system
-        // for the parameters b[]
-        band_matrix A(n,1,1);
-        std::vector<double>  rhs(n);
+        // setting up the tridiagonal matrix and right hand side of the
+        // equation system for the parameters b[], the rhs goes directly
+        // into b[] and is solved in place
+        double* rhs=b;
         for(int i=1; i<n-1; i++) {
-            A(i,i-1)=1.0/3.0*(x[i]-x[i-1]);
-            A(i,i)=2.0/3.0*(x[i+1]-x[i-1]);
-            A(i,i+1)=1.0/3.0*(x[i+1]-x[i]);
+            lower[i]=1.0/3.0*(x[i]-x[i-1]);
+            diag[i]=2.0/3.0*(x[i+1]-x[i-1]);
+            upper[i]=1.0/3.0*(x[i+1]-x[i]);
             rhs[i]=(y[i+1]-y[i])/(x[i+1]-x[i]) - (y[i]-y[i-1])/(x[i]-x[i-1]);
         }
         // boundary conditions
-        if(m_left == spline::second_deriv) {
+        if(left == spline::second_deriv) {
             // 2*b[0] = f''
-            A(0,0)=2.0;
-            A(0,1)=0.0;
-            rhs[0]=m_left_value;
-        } else if(m_left == spline::first_deriv) {
+            diag[0]=2.0;
+            upper[0]=0.0;
+            rhs[0]=left_value;
+        } else if(left == spline::first_deriv) {
             // c[0] = f', needs to be re-expressed in terms of b:
             // (2b[0]+b[1])(x[1]-x[0]) = 3 ((y[1]-y[0])/(x[1]-x[0]) - f')
-            A(0,0)=2.0*(x[1]-x[0]);
-            A(0,1)=1.0*(x[1]-x[0]);
-            rhs[0]=3.0*((y[1]-y[0])/(x[1]-x[0])-m_left_value);
+            diag[0]=2.0*(x[1]-x[0]);
+            upper[0]=1.0*(x[1]-x[0]);
+            rhs[0]=3.0*((y[1]-y[0])/(x[1]-x[0])-left_value);
         } else {
             assert(false);
         }
-        if(m_right == spline::second_deriv) {
+        if(right == spline::second_deriv) {
             // 2*b[n-1] = f''
-            A(n-1,n-1)=2.0;
-            A(n-1,n-2)=0.0;
-            rhs[n-1]=m_right_value;
-        } else if(m_right == spline::first_deriv) {
+            diag[n-1]=2.0;
+            lower[n-1]=0.0;
+            rhs[n-1]=right_value;
+        } else if(right == spline::first_deriv) {
             // c[n-1] = f', needs to be re-expressed in terms of b:
             // (b[n-2]+2b[n-1])(x[n-1]-x[n-2])
             // = 3 (f' - (y[n-1]-y[n-2])/(x[n-1]-x[n-2]))
-            A(n-1,n-1)=2.0*(x[n-1]-x[n-2]);
-            A(n-1,n-2)=1.0*(x[n-1]-x[n-2]);
-            rhs[n-1]=3.0*(m_right_value-(y[n-1]-y[n-2])/(x[n-1]-x[n-2]));
+            diag[n-1]=2.0*(x[n-1]-x[n-2]);
+            lower[n-1]=1.0*(x[n-1]-x[n-2]);
+            rhs[n-1]=3.0*(right_value-(y[n-1]-y[n-2])/(x[n-1]-x[n-2]));
         } else {
             assert(false);
         }
 
         // solve the equation system to obtain the parameters b[]
-        m_b=A.lu_solve(rhs);
+        tridiagonal_solve(n, lower, diag, upper, b);
 
         // calculate parameters a[] and c[] based on b[]
-        m_a.resize(n);
-        m_c.resize(n);
         for(int i=0; i<n-1; i++) {
-            m_a[i]=1.0/3.0*(m_b[i+1]-m_b[i])/(x[i+1]-x[i]);
-            m_c[i]=(y[i+1]-y[i])/(x[i+1]-x[i])
-                   - 1.0/3.0*(2.0*m_b[i]+m_b[i+1])*(x[i+1]-x[i]);
+            a[i]=1.0/3.0*(b[i+1]-b[i])/(x[i+1]-x[i]);
+            c[i]=(y[i+1]-y[i])/(x[i+1]-x[i])
+                 - 1.0/3.0*(2.0*b[i]+b[i+1])*(x[i+1]-x[i]);
         }
     } else { // linear interpolation
-        m_a.resize(n);
-        m_b.resize(n);
-        m_c.resize(n);
         for(int i=0; i<n-1; i++) {
-            m_a[i]=0.0;
-            m_b[i]=0.0;
-            m_c[i]=(m_y[i+1]-m_y[i])/(m_x[i+1]-m_x[i]);
+            a[i]=0.0;
+            b[i]=0.0;
+            c[i]=(y[i+1]-y[i])/(x[i+1]-x[i]);
         }
+        b[n-1]=0.0;
     }
 
     // for left extrapolation coefficients
-    m_b0 = (m_force_linear_extrapolation==false) ? m_b[0] : 0.0;
-    m_c0 = m_c[0];
+    b0 = (force_linear_extrapolation==false) ? b[0] : 0.0;
+    c0 = c[0];
 
     // for the right extrapolation coefficients
     // f_{n-1}(x) = b*(x-x_{n-1})^2 + c*(x-x_{n-1}) + y_{n-1}
     double h=x[n-1]-x[n-2];
-    // m_b[n-1] is determined by the boundary condition
-    m_a[n-1]=0.0;
-    m_c[n-1]=3.0*m_a[n-2]*h*h+2.0*m_b[n-2]*h+m_c[n-2];   // = f'_{n-2}(x_{n-1})
-    if(m_force_linear_extrapolation==true)
-        m_b[n-1]=0.0;
+    // b[n-1] is determined by the boundary condition
+    a[n-1]=0.0;
+    c[n-1]=3.0*a[n-2]*h*h+2.0*b[n-2]*h+c[n-2];   // = f'_{n-2}(x_{n-1})
+    if(force_linear_extrapolation==true)
+        b[n-1]=0.0;
 }
 
-double spline::operator() (double x) const
+
+// spline_view implementation
+// --------------------------
+
+int spline_view::piece(double xq) const
 {
-    size_t n=m_x.size();
-    // find the closest point m_x[idx] < x, idx=0 even if x<m_x[0]
-    std::vector<double>::const_iterator it;
-    it=std::lower_bound(m_x.begin(),m_x.end(),x);
-    int idx=std::max( int(it-m_x.begin())-1, 0);
+    if(xq<x[0]) {
+        return -1;
+    } else if(xq>x[n-1]) {
+        return n-1;
+    }
+    // find the closest point x[idx] < xq, idx=0 even if xq==x[0]
+    const double* it=std::lower_bound(x,x+n,xq);
+    return std::max( int(it-x)-1, 0);
+}
 
-    double h=x-m_x[idx];
-    double interpol;
-    if(x<m_x[0]) {
+void spline_view::piece_coeffs(int idx, double& x0, double& y0,
+                               double& pa, double& pb, double& pc) const
+{
+    if(idx<0) {
         // extrapolation to the left
-        interpol=(m_b0*h + m_c0)*h + m_y[0];
-    } else if(x>m_x[n-1]) {
-        // extrapolation to the right
-        interpol=(m_b[n-1]*h + m_c[n-1])*h + m_y[n-1];
+        x0=x[0];
+        y0=y[0];
+        pa=0.0;
+        pb=b0;
+        pc=c0;
     } else {
-        // interpolation
-        interpol=((m_a[idx]*h + m_b[idx])*h + m_c[idx])*h + m_y[idx];
+        // interpolation, or extrapolation to the right with a[n-1]=0
+        x0=x[idx];
+        y0=y[idx];
+        pa=a[idx];
+        pb=b[idx];
+        pc=c[idx];
+    }
+}
+
+template<class F>
+void spline_view::eval_runs(const double* xs, double* ys, size_t m,
+                            F f) const
+{
+    double x0, y0, pa, pb, pc;
+    size_t k=0;
+    for(int idx=-1; idx<n && k<m; idx++) {
+        // samples up to x[idx+1] belong to this piece, the right
+        // extrapolation takes the rest
+        size_t end=k;
+        if(idx<n-1) {
+            while(end<m && (idx<0 ? xs[end]<x[0] : xs[end]<=x[idx+1])) end++;
+        } else {
+            end=m;
+        }
+        piece_coeffs(idx, x0, y0, pa, pb, pc);
+        for(; k<end; k++) {
+            ys[k]=f(xs[k]-x0, pa, pb, pc, y0);
+        }
+    }
+}
+
+// f and its derivatives on one piece, Horner form
+struct spline_poly {
+    static double eval(double h, double pa, double pb, double pc, double y0)
+    {
+        return ((pa*h + pb)*h + pc)*h + y0;
+    }
+    static double deriv1(double h, double pa, double pb, double pc, double)
+    {
+        return (3.0*pa*h + 2.0*pb)*h + pc;
+    }
+    static double deriv2(double h, double pa, double pb, double, double)
+    {
+        return 6.0*pa*h + 2.0*pb;
+    }
+    static double deriv3(double, double pa, double, double, double)
+    {
+        return 6.0*pa;
+    }
+};
+
+double spline_view::operator() (double xq) const
+{
+    double x0, y0, pa, pb, pc;
+    piece_coeffs(piece(xq), x0, y0, pa, pb, pc);
+    return spline_poly::eval(xq-x0, pa, pb, pc, y0);
+}
+
+double spline_view::deriv(int order, double xq) const
+{
+    assert(order>0 && order<=3);
+    double x0, y0, pa, pb, pc;
+    piece_coeffs(piece(xq), x0, y0, pa, pb, pc);
+    double h=xq-x0;
+    switch(order) {
+    case 1:
+        return spline_poly::deriv1(h, pa, pb, pc, y0);
+    case 2:
+        return spline_poly::deriv2(h, pa, pb, pc, y0);
+    default:
+        return spline_poly::deriv3(h, pa, pb, pc, y0);
+    }
+}
+
+void spline_view::eval_batch(const double* xs, double* ys, size_t m) const
+{
+    for(size_t k=0; k<m; k++) {
+        ys[k]=this->operator()(xs[k]);
+    }
+}
+
+void spline_view::eval_batch_sorted(const double* xs, double* ys,
+                                    size_t m) const
+{
+    eval_runs(xs, ys, m, spline_poly::eval);
+}
+
+void spline_view::deriv_batch(int order, const double* xs, double* ys,
+                              size_t m) const
+{
+    for(size_t k=0; k<m; k++) {
+        ys[k]=deriv(order, xs[k]);
+    }
+}
+
+void spline_view::deriv_batch_sorted(int order, const double* xs,
+                                     double* ys, size_t m) const
+{
+    assert(order>0 && order<=3);
+    switch(order) {
+    case 1:
+        eval_runs(xs, ys, m, spline_poly::deriv1);
+        break;
+    case 2:
+        eval_runs(xs, ys, m, spline_poly::deriv2);
+        break;
+    default:
+        eval_runs(xs, ys, m, spline_poly::deriv3);
+        break;
+    }
+}
+
+
+// static_spline implementation
+// ----------------------------
+
+template<int N>
+void static_spline<N>::set_boundary(bd_type left, double left_value,
+                                    bd_type right, double right_value,
+                                    bool force_linear_extrapolation)
+{
+    m_left=left;
+    m_right=right;
+    m_left_value=left_value;
+    m_right_value=right_value;
+    m_force_linear_extrapolation=force_linear_extrapolation;
+}
+
+template<int N>
+void static_spline<N>::set_points(const double* x, const double* y, int n,
+                                  bool cubic_spline)
+{
+    assert(n>2);
+    assert(n<=N);
+    std::copy(x, x+n, m_x.begin());
+    std::copy(y, y+n, m_y.begin());
+    m_n=n;
+    spline_coefficients(n, m_x.data(), m_y.data(), cubic_spline,
+                        m_left, m_left_value, m_right, m_right_value,
+                        m_force_linear_extrapolation,
+                        m_a.data(), m_b.data(), m_c.data(), m_b0, m_c0,
+                        m_lower.data(), m_diag.data(), m_upper.data());
+}
+
+template<int N>
+double static_spline<N>::operator() (double x) const
+{
+    return view()(x);
+}
+
+template<int N>
+spline_view static_spline<N>::view() const
+{
+    spline_view v;
+    v.n=m_n;
+    v.x=m_x.data();
+    v.y=m_y.data();
+    v.a=m_a.data();
+    v.b=m_b.data();
+    v.c=m_c.data();
+    v.b0=m_b0;
+    v.c0=m_c0;
+    return v;
+}
+
+
+// arc_length_sampler implementation
+// ---------------------------------
+
+// 5 point Gauss-Legendre rule on [-1,1]
+struct gauss_legendre5 {
+    static double node(int i)
+    {
+        static const double n[5]= {
+            -0.9061798459386640, -0.5384693101056831, 0.0,
+            0.5384693101056831, 0.9061798459386640
+        };
+        return n[i];
+    }
+    static double weight(int i)
+    {
+        static const double w[5]= {
+            0.2369268850561891, 0.4786286704993665, 0.5688888888888889,
+            0.4786286704993665, 0.2369268850561891
+        };
+        return w[i];
+    }
+};
+
+template<int N>
+double arc_length_sampler<N>::piece_length(int idx, double x_a,
+        double x_b) const
+{
+    double x0, y0, pa, pb, pc;
+    m_spline.piece_coeffs(idx, x0, y0, pa, pb, pc);
+    double mid=0.5*(x_a+x_b);
+    double half=0.5*(x_b-x_a);
+    double sum=0.0;
+    for(int i=0; i<5; i++) {
+        double h=mid+half*gauss_legendre5::node(i)-x0;
+        double dy=spline_poly::deriv1(h, pa, pb, pc, y0);
+        sum += gauss_legendre5::weight(i)*std::sqrt(1.0+dy*dy);
+    }
+    return half*sum;
+}
+
+template<int N>
+void arc_length_sampler<N>::build(const spline_view& s)
+{
+    assert(s.n>1 && s.n<=N);
+    m_spline=s;
+    m_len[0]=0.0;
+    for(int i=0; i<s.n-1; i++) {
+        m_len[i+1]=m_len[i]+piece_length(i, s.x[i], s.x[i+1]);
+    }
+}
+
+template<int N>
+double arc_length_sampler<N>::length_at(double x) const
+{
+    assert(x>=m_spline.x[0]);
+    int idx=m_spline.piece(x);
+    return m_len[idx]+piece_length(idx, m_spline.x[idx], x);
+}
+
+template<int N>
+double arc_length_sampler<N>::x_at(double len) const
+{
+    double x;
+    sample(m_spline.x[0], len, 1, &x, NULL);
+    return x;
+}
+
+template<int N>
+void arc_length_sampler<N>::sample(double x_start, const double* ds,
+                                   size_t m, double* xs, double* ys) const
+{
+    const int n=m_spline.n;
+    const double* kx=m_spline.x;
+    double len=length_at(x_start);
+    int idx=m_spline.piece(x_start);
+    double x=x_start;
+    for(size_t k=0; k<m; k++) {
+        len += ds[k];
+        // lengths only grow, so the segment index only moves forward; past
+        // the last knot the right extrapolation takes over
+        while(idx<n-1 && len>m_len[idx+1]) idx++;
+        double x_a=kx[idx];
+        double x_b=(idx<n-1) ? kx[idx+1] : x_a+len-m_len[idx];
+        // start from the previous point moved by ds (arc >= chord), then
+        // Newton on L(x)-len with L'(x)=sqrt(1+y'^2)
+        x=std::min(std::max(x+ds[k], x_a), std::max(x_b, x_a));
+        double x0, y0, pa, pb, pc;
+        m_spline.piece_coeffs(idx, x0, y0, pa, pb, pc);
+        for(int it=0; it<4; it++) {
+            double err=m_len[idx]+piece_length(idx, x_a, x)-len;
+            double dy=spline_poly::deriv1(x-x0, pa, pb, pc, y0);
+            x -= err/std::sqrt(1.0+dy*dy);
+        }
+        xs[k]=x;
+    }
+    if(ys!=NULL) {
+        m_spline.eval_batch_sorted(xs, ys, m);
+    }
+}
+
+template<int N>
+void arc_length_sampler<N>::sample(double x_start, double ds, size_t m,
+                                   double* xs, double* ys) const
+{
+    // xs doubles as the step array, it is overwritten front to back
+    // and each step is read before its slot is written
+    for(size_t k=0; k<m; k++) {
+        xs[k]=ds;
     }
-    return interpol;
+    sample(x_start, xs, m, xs, ys);
 }
 
 
@@ -0,0 +1,379 @@
+#include "telemetry.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+namespace {
+
+// longest number copied to the stack for strtod when the fast path does
+// not apply
+const int kMaxNumberLength = 64;
+
+// nesting limit when skipping values we don't care about
+const int kMaxDepth = 32;
+
+// keys every telemetry frame has to carry
+enum TelemetryField {
+  kFieldX = 1 << 0,
+  kFieldY = 1 << 1,
+  kFieldS = 1 << 2,
+  kFieldD = 1 << 3,
+  kFieldYaw = 1 << 4,
+  kFieldSpeed = 1 << 5,
+  kFieldPreviousPathX = 1 << 6,
+  kFieldPreviousPathY = 1 << 7,
+  kFieldEndPathS = 1 << 8,
+  kFieldEndPathD = 1 << 9,
+  kFieldSensorFusion = 1 << 10,
+  kAllFields = (1 << 11) - 1
+};
+
+// powers of ten that are exact in a double
+const double kPow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Cursor over the frame. Every read checks against end_, the buffer is
+// never assumed to be null terminated.
+class Reader {
+ public:
+  Reader(const char *begin, const char *end) : p_(begin), end_(end) {}
+
+  void skipSpace() {
+    while (p_ < end_ &&
+           (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+      ++p_;
+    }
+  }
+
+  // consumes c (after whitespace) if it is next
+  bool consume(char c) {
+    skipSpace();
+    if (p_ < end_ && *p_ == c) {
+      ++p_;
+      return true;
+    }
+    return false;
+  }
+
+  bool consumeLiteral(const char *literal) {
+    skipSpace();
+    size_t n = strlen(literal);
+    if ((size_t)(end_ - p_) < n || memcmp(p_, literal, n) != 0) {
+      return false;
+    }
+    p_ += n;
+    return true;
+  }
+
+  // reads a string without escapes, returning a pointer into the buffer
+  bool string(const char *&str, size_t &len) {
+    if (!consume('"')) {
+      return false;
+    }
+    str = p_;
+    while (p_ < end_ && *p_ != '"') {
+      if (*p_ == '\\') {
+        // escapes never show up in keys or event names we look for, so
+        // just step over them and let the comparison fail
+        if (++p_ == end_) {
+          return false;
+        }
+      }
+      ++p_;
+    }
+    if (p_ == end_) {
+      return false;
+    }
+    len = p_ - str;
+    ++p_;
+    return true;
+  }
+
+  // JSON number, read to the same double as json::parse does. Up to 19
+  // significant digits are accumulated in an integer and scaled by an exact
+  // power of ten, which is correctly rounded as long as the mantissa fits
+  // in 53 bits and the exponent is small. Everything else goes through
+  // strtod on a copy. Numbers out of the double range fail like they do
+  // for json::parse (which turns them into null).
+  bool number(double &value) {
+    skipSpace();
+    const char *start = p_;
+    bool negative = false;
+    if (p_ < end_ && *p_ == '-') {
+      negative = true;
+      ++p_;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool integral = true;
+    const char *int_start = p_;
+    while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p_ - '0');
+        if (mantissa) {
+          ++digits;
+        }
+      } else {
+        ++exponent;
+      }
+      ++p_;
+    }
+    // at least one digit and no leading zeros
+    if (p_ == int_start || (*int_start == '0' && p_ - int_start > 1)) {
+      return false;
+    }
+    if (p_ < end_ && *p_ == '.') {
+      ++p_;
+      integral = false;
+      const char *frac_start = p_;
+      while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+        if (digits < 19) {
+          mantissa = mantissa * 10 + (*p_ - '0');
+          if (mantissa) {
+            ++digits;
+          }
+          --exponent;
+        }
+        ++p_;
+      }
+      if (p_ == frac_start) {
+        return false;
+      }
+    }
+    if (p_ < end_ && (*p_ == 'e' || *p_ == 'E')) {
+      ++p_;
+      integral = false;
+      bool exp_negative = false;
+      if (p_ < end_ && (*p_ == '+' || *p_ == '-')) {
+        exp_negative = *p_ == '-';
+        ++p_;
+      }
+      int e = 0;
+      bool exp_any = false;
+      while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+        if (e < 10000) {
+          e = e * 10 + (*p_ - '0');
+        }
+        exp_any = true;
+        ++p_;
+      }
+      if (!exp_any) {
+        return false;
+      }
+      exponent += exp_negative ? -e : e;
+    }
+    // json::parse reads -0 as the integer 0, only -0.0 is negative zero
+    if (integral && mantissa == 0) {
+      negative = false;
+    }
+
+    if (mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+      value = (double)mantissa;
+      value = exponent < 0 ? value / kPow10[-exponent]
+                           : value * kPow10[exponent];
+      if (negative) {
+        value = -value;
+      }
+      return true;
+    }
+    size_t len = p_ - start;
+    if (len < (size_t)kMaxNumberLength) {
+      char buffer[kMaxNumberLength];
+      memcpy(buffer, start, len);
+      buffer[len] = '\0';
+      value = strtod(buffer, NULL);
+    } else {
+      // absurdly long numbers are rare enough to allocate for
+      value = strtod(std::string(start, len).c_str(), NULL);
+    }
+    return isfinite(value);
+  }
+
+  // skips over any JSON value
+  bool skipValue(int depth = 0) {
+    if (depth > kMaxDepth) {
+      return false;
+    }
+    skipSpace();
+    if (p_ == end_) {
+      return false;
+    }
+    const char *str;
+    size_t len;
+    double value;
+    switch (*p_) {
+      case '"':
+        return string(str, len);
+      case '{':
+        ++p_;
+        if (consume('}')) {
+          return true;
+        }
+        do {
+          if (!string(str, len) || !consume(':') || !skipValue(depth + 1)) {
+            return false;
+          }
+        } while (consume(','));
+        return consume('}');
+      case '[':
+        ++p_;
+        if (consume(']')) {
+          return true;
+        }
+        do {
+          if (!skipValue(depth + 1)) {
+            return false;
+          }
+        } while (consume(','));
+        return consume(']');
+      case 't':
+        return consumeLiteral("true");
+      case 'f':
+        return consumeLiteral("false");
+      case 'n':
+        return consumeLiteral("null");
+      default:
+        return number(value);
+    }
+  }
+
+  // [v0, v1, ...] into out, at most capacity values
+  bool numberArray(double *out, int capacity, int &count) {
+    count = 0;
+    if (!consume('[')) {
+      return false;
+    }
+    if (consume(']')) {
+      return true;
+    }
+    do {
+      if (count == capacity || !number(out[count])) {
+        return false;
+      }
+      ++count;
+    } while (consume(','));
+    return consume(']');
+  }
+
+  // [[id, x, y, vx, vy, s, d], ...]
+  bool sensorFusion(Telemetry &t) {
+    t.num_vehicles = 0;
+    if (!consume('[')) {
+      return false;
+    }
+    if (consume(']')) {
+      return true;
+    }
+    do {
+      int fields;
+      if (t.num_vehicles == kMaxVehicles ||
+          !numberArray(t.sensor_fusion[t.num_vehicles], 7, fields) ||
+          fields != 7) {
+        return false;
+      }
+      ++t.num_vehicles;
+    } while (consume(','));
+    return consume(']');
+  }
+
+ private:
+  const char *p_;
+  const char *end_;
+};
+
+bool keyIs(const char *key, size_t len, const char *name) {
+  return strlen(name) == len && memcmp(key, name, len) == 0;
+}
+
+}  // namespace
+
+TelemetryStatus parseTelemetry(const char *data, size_t length, Telemetry &t) {
+  // "42" at the start of the message means there's a websocket message event.
+  // The 4 signifies a websocket message
+  // The 2 signifies a websocket event
+  if (length <= 2 || data[0] != '4' || data[1] != '2') {
+    return kTelemetryOther;
+  }
+  Reader r(data + 2, data + length);
+
+  const char *event;
+  size_t event_len;
+  if (!r.consume('[') || !r.string(event, event_len)) {
+    return kTelemetryManual;
+  }
+  if (!r.consume(',') || r.consumeLiteral("null")) {
+    return kTelemetryManual;
+  }
+  if (!keyIs(event, event_len, "telemetry")) {
+    return kTelemetryOther;
+  }
+
+  // t keeps the values of the last frame, so a frame has to set them all
+  t.prev_size = 0;
+  t.num_vehicles = 0;
+  if (!r.consume('{') || r.consume('}')) {
+    return kTelemetryMalformed;
+  }
+  int num_prev_x = 0;
+  int num_prev_y = 0;
+  int seen = 0;
+  do {
+    const char *key;
+    size_t len;
+    if (!r.string(key, len) || !r.consume(':')) {
+      return kTelemetryMalformed;
+    }
+    bool ok;
+    if (keyIs(key, len, "x")) {
+      ok = r.number(t.x);
+      seen |= kFieldX;
+    } else if (keyIs(key, len, "y")) {
+      ok = r.number(t.y);
+      seen |= kFieldY;
+    } else if (keyIs(key, len, "s")) {
+      ok = r.number(t.s);
+      seen |= kFieldS;
+    } else if (keyIs(key, len, "d")) {
+      ok = r.number(t.d);
+      seen |= kFieldD;
+    } else if (keyIs(key, len, "yaw")) {
+      ok = r.number(t.yaw);
+      seen |= kFieldYaw;
+    } else if (keyIs(key, len, "speed")) {
+      ok = r.number(t.speed);
+      seen |= kFieldSpeed;
+    } else if (keyIs(key, len, "previous_path_x")) {
+      ok = r.numberArray(t.previous_path_x, kMaxPathPoints, num_prev_x);
+      seen |= kFieldPreviousPathX;
+    } else if (keyIs(key, len, "previous_path_y")) {
+      ok = r.numberArray(t.previous_path_y, kMaxPathPoints, num_prev_y);
+      seen |= kFieldPreviousPathY;
+    } else if (keyIs(key, len, "end_path_s")) {
+      ok = r.number(t.end_path_s);
+      seen |= kFieldEndPathS;
+    } else if (keyIs(key, len, "end_path_d")) {
+      ok = r.number(t.end_path_d);
+      seen |= kFieldEndPathD;
+    } else if (keyIs(key, len, "sensor_fusion")) {
+      ok = r.sensorFusion(t);
+      seen |= kFieldSensorFusion;
+    } else {
+      ok = r.skipValue();
+    }
+    if (!ok) {
+      return kTelemetryMalformed;
+    }
+  } while (r.consume(','));
+  if (!r.consume('}') || seen != kAllFields || num_prev_x != num_prev_y) {
+    return kTelemetryMalformed;
+  }
+  t.prev_size = num_prev_x;
+  return kTelemetryOk;
+}
@@ -0,0 +1,50 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+
+// Capacity of the fixed telemetry arrays. The simulator reports 12 cars and
+// hands back at most the 50 points we sent, the vehicle limit leaves room
+// for the dense traffic scenarios.
+const int kMaxVehicles = 256;
+const int kMaxPathPoints = 256;
+
+// One telemetry frame from the simulator, laid out as plain arrays so a
+// single instance can be reused for every message without allocating.
+struct Telemetry {
+  // main car's localization data
+  double x;
+  double y;
+  double s;
+  double d;
+  double yaw;
+  double speed;
+
+  // previous path given to the planner and its end s and d values
+  int prev_size;
+  double previous_path_x[kMaxPathPoints];
+  double previous_path_y[kMaxPathPoints];
+  double end_path_s;
+  double end_path_d;
+
+  // other cars on our side of the road: [id, x, y, vx, vy, s, d]
+  int num_vehicles;
+  double sensor_fusion[kMaxVehicles][7];
+};
+
+enum TelemetryStatus {
+  kTelemetryOk,        // telemetry frame parsed into the struct
+  kTelemetryManual,    // socket.io event without data (manual driving)
+  kTelemetryOther,     // not a telemetry event, nothing to do
+  kTelemetryMalformed  // broken frame, a field missing or more data than
+                       // the arrays hold
+};
+
+// Parses a socket.io frame 42["telemetry",{...}] straight from the
+// websocket buffer (not null terminated) into t. Keys are matched by name
+// in any order and unknown keys are skipped, nothing is copied or
+// allocated on the way. Every field of Telemetry has to be in the frame,
+// numbers are read to the same doubles as json::parse gives.
+TelemetryStatus parseTelemetry(const char *data, size_t length, Telemetry &t);
+
+#endif /* TELEMETRY_H */
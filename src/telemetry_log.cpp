@@ -0,0 +1,261 @@
+#include "telemetry_log.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+// Integers in the file are little endian. Converts between that and the
+// host order, both ways; a no-op on little endian hosts.
+uint32_t littleEndian(uint32_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap32(v);
+#else
+  return v;
+#endif
+}
+
+uint64_t littleEndian(uint64_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap64(v);
+#else
+  return v;
+#endif
+}
+
+// header as it is stored in the file
+LogRecordHeader fileHeader(uint32_t type, uint32_t length, int64_t time_ns) {
+  LogRecordHeader header;
+  header.type = littleEndian(type);
+  header.length = littleEndian(length);
+  header.time_ns = (int64_t)littleEndian((uint64_t)time_ns);
+  return header;
+}
+
+// records are packed, the header is not necessarily aligned
+LogRecordHeader readHeader(const char *p) {
+  LogRecordHeader header;
+  memcpy(&header, p, sizeof(header));
+  return fileHeader(header.type, header.length, header.time_ns);
+}
+
+}  // namespace
+
+TelemetryLogWriter::TelemetryLogWriter()
+    : file_(NULL), offset_(0), failed_(false) {}
+
+TelemetryLogWriter::~TelemetryLogWriter() {
+  close();
+}
+
+bool TelemetryLogWriter::open(const string &path) {
+  close();
+  file_ = fopen(path.c_str(), "wb");
+  if (!file_) {
+    cerr << "Failed to create log " << path << endl;
+    return false;
+  }
+  path_ = path;
+  offset_ = 0;
+  failed_ = false;
+  index_.clear();
+  write(kLogMagic, sizeof(kLogMagic));
+  return true;
+}
+
+bool TelemetryLogWriter::close() {
+  if (!file_) {
+    return true;
+  }
+  // A log with a failed write is left without index and footer, readers
+  // then scan it up to the last complete record. The index is a record of
+  // its own, so scanning a log whose footer got lost stops in front of it.
+  if (!failed_) {
+    LogRecordHeader header = fileHeader(
+        kLogIndex, (uint32_t)(index_.size() * sizeof(uint64_t)), 0);
+    uint64_t index_offset = offset_ + sizeof(header);
+    write(&header, sizeof(header));
+    for (size_t i = 0; i < index_.size(); ++i) {
+      index_[i] = littleEndian(index_[i]);
+    }
+    if (!index_.empty()) {
+      write(&index_[0], index_.size() * sizeof(uint64_t));
+    }
+    LogFooter footer;
+    footer.index_offset = littleEndian(index_offset);
+    footer.count = littleEndian((uint64_t)index_.size());
+    memcpy(footer.magic, kLogIndexMagic, sizeof(footer.magic));
+    write(&footer, sizeof(footer));
+  }
+  if (fclose(file_) != 0) {
+    failed_ = true;
+  }
+  file_ = NULL;
+  if (failed_) {
+    cerr << "Failed to write log " << path_ << ", it is incomplete" << endl;
+  }
+  return !failed_;
+}
+
+void TelemetryLogWriter::append(LogRecordType type, int64_t time_ns,
+                                const char *data, size_t length) {
+  // nothing more is written after a failed write, so the log stays
+  // readable up to the last complete record
+  if (!file_ || failed_) {
+    return;
+  }
+  LogRecordHeader header = fileHeader(type, (uint32_t)length, time_ns);
+  uint64_t offset = offset_;
+  if (write(&header, sizeof(header)) && write(data, length)) {
+    index_.push_back(offset);
+  }
+}
+
+bool TelemetryLogWriter::write(const void *data, size_t length) {
+  if (failed_) {
+    return false;
+  }
+  if (fwrite(data, 1, length, file_) != length) {
+    failed_ = true;
+    return false;
+  }
+  offset_ += length;
+  return true;
+}
+
+TelemetryLogReader::TelemetryLogReader()
+    : base_(NULL), file_size_(0), records_end_(0), indexed_(false) {}
+
+TelemetryLogReader::~TelemetryLogReader() {
+  close();
+}
+
+bool TelemetryLogReader::open(const string &path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    cerr << "Failed to open log " << path << endl;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(kLogMagic)) {
+    cerr << path << " is not a telemetry log" << endl;
+    ::close(fd);
+    return false;
+  }
+  file_size_ = st.st_size;
+  void *map = mmap(NULL, file_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid without the descriptor
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    cerr << "Failed to map log " << path << endl;
+    file_size_ = 0;
+    return false;
+  }
+  base_ = static_cast<const char *>(map);
+  if (memcmp(base_, kLogMagic, sizeof(kLogMagic)) != 0) {
+    cerr << path << " is not a telemetry log" << endl;
+    close();
+    return false;
+  }
+
+  indexed_ = readIndex();
+  if (!indexed_) {
+    scanRecords();
+  }
+  return true;
+}
+
+void TelemetryLogReader::close() {
+  if (base_) {
+    munmap(const_cast<char *>(base_), file_size_);
+    base_ = NULL;
+  }
+  file_size_ = 0;
+  records_end_ = 0;
+  indexed_ = false;
+  offsets_.clear();
+}
+
+LogRecord TelemetryLogReader::record(size_t i) const {
+  LogRecordHeader header = readHeader(base_ + offsets_[i]);
+  // a length running into the next record is cut off there, so a broken
+  // index can't hand out bytes outside the records
+  uint64_t end = i + 1 < offsets_.size() ? offsets_[i + 1] : records_end_;
+  LogRecord r;
+  r.type = (LogRecordType)header.type;
+  r.time_ns = header.time_ns;
+  r.data = base_ + offsets_[i] + sizeof(header);
+  r.length = min((uint64_t)header.length, end - offsets_[i] - sizeof(header));
+  return r;
+}
+
+bool TelemetryLogReader::readIndex() {
+  if (file_size_ < sizeof(kLogMagic) + sizeof(LogFooter)) {
+    return false;
+  }
+  LogFooter footer;
+  memcpy(&footer, base_ + file_size_ - sizeof(footer), sizeof(footer));
+  footer.index_offset = littleEndian(footer.index_offset);
+  footer.count = littleEndian(footer.count);
+  uint64_t end = file_size_ - sizeof(footer);
+  if (memcmp(footer.magic, kLogIndexMagic, sizeof(footer.magic)) != 0 ||
+      footer.index_offset < sizeof(kLogMagic) + sizeof(LogRecordHeader) ||
+      footer.index_offset > end ||
+      footer.count != (end - footer.index_offset) / sizeof(uint64_t) ||
+      (end - footer.index_offset) % sizeof(uint64_t) != 0) {
+    return false;
+  }
+
+  offsets_.resize(footer.count);
+  if (footer.count) {
+    memcpy(&offsets_[0], base_ + footer.index_offset,
+           footer.count * sizeof(uint64_t));
+  }
+  // Offsets have to increase and the last record has to end where the
+  // index starts. Only its header is read, so opening a huge log doesn't
+  // touch the pages of every record, the others are bounded by record().
+  uint64_t records_end = footer.index_offset - sizeof(LogRecordHeader);
+  uint64_t next = sizeof(kLogMagic);
+  for (size_t i = 0; i < offsets_.size(); ++i) {
+    offsets_[i] = littleEndian(offsets_[i]);
+    if (offsets_[i] < next || offsets_[i] + sizeof(LogRecordHeader) > records_end) {
+      offsets_.clear();
+      return false;
+    }
+    next = offsets_[i] + sizeof(LogRecordHeader);
+  }
+  if (!offsets_.empty()) {
+    LogRecordHeader header = readHeader(base_ + offsets_.back());
+    if (offsets_.back() + sizeof(header) + header.length != records_end) {
+      offsets_.clear();
+      return false;
+    }
+  }
+  records_end_ = records_end;
+  return true;
+}
+
+void TelemetryLogReader::scanRecords() {
+  offsets_.clear();
+  uint64_t offset = sizeof(kLogMagic);
+  LogRecordHeader header;
+  while (offset + sizeof(header) <= file_size_) {
+    header = readHeader(base_ + offset);
+    if ((header.type != kLogTelemetry && header.type != kLogControl) ||
+        offset + sizeof(header) + header.length > file_size_) {
+      break;
+    }
+    offsets_.push_back(offset);
+    offset += sizeof(header) + header.length;
+  }
+  records_end_ = offset;
+}
@@ -0,0 +1,109 @@
+#ifndef TELEMETRY_LOG_H
+#define TELEMETRY_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// Binary log of the messages exchanged with one simulator.
+//
+// The file starts with the 8 byte kLogMagic, followed by records appended
+// in the order they happened. Every record is a fixed LogRecordHeader and
+// the raw websocket payload, so a replay goes through the same parser as
+// the live server. A log closed cleanly ends in a kLogIndex record with the
+// file offset of every record before it, then a LogFooter. All integers
+// are little endian, whatever the byte order of the host.
+const char kLogMagic[8] = {'P', 'P', 'L', 'O', 'G', 0, 0, 1};
+const char kLogIndexMagic[8] = {'P', 'P', 'L', 'O', 'G', 'I', 'D', 'X'};
+
+enum LogRecordType {
+  kLogTelemetry = 1,  // message received from the simulator
+  kLogControl = 2,    // control message sent back
+  kLogIndex = 3       // uint64_t offsets of the records, ends the log
+};
+
+struct LogRecordHeader {
+  uint32_t type;
+  uint32_t length;   // payload bytes following the header
+  int64_t time_ns;   // since the start of the session
+};
+
+struct LogFooter {
+  uint64_t index_offset;  // payload of the kLogIndex record
+  uint64_t count;         // number of records
+  char magic[8];          // kLogIndexMagic
+};
+
+// Appends records to a log file. Writes are buffered by stdio, a record is
+// complete on disk at the latest when the writer is closed. After a write
+// fails (disk full) nothing more is written and close() reports it.
+class TelemetryLogWriter {
+ public:
+  TelemetryLogWriter();
+  ~TelemetryLogWriter();
+
+  // Creates (or truncates) path and writes the file header
+  bool open(const std::string &path);
+  // Writes the index and closes the file. False if any write failed, the
+  // log then has no index.
+  bool close();
+  bool isOpen() const { return file_ != NULL; }
+
+  void append(LogRecordType type, int64_t time_ns, const char *data,
+              size_t length);
+
+ private:
+  bool write(const void *data, size_t length);
+
+  FILE *file_;
+  std::string path_;
+  uint64_t offset_;
+  bool failed_;
+  std::vector<uint64_t> index_;
+};
+
+// A record inside a mapped log, data points into the mapping
+struct LogRecord {
+  LogRecordType type;
+  int64_t time_ns;
+  const char *data;
+  size_t length;
+};
+
+// Random access to the records of a log mapped into memory.
+//
+// Record offsets come from the index at the end of the file. Logs without
+// one (the recording was cut short) are scanned once on open instead, up
+// to the last complete record. Records are handed out as views into the
+// mapping without copying, and the reader is not modified after open(),
+// so any number of threads can read disjoint (or the same) ranges.
+class TelemetryLogReader {
+ public:
+  TelemetryLogReader();
+  ~TelemetryLogReader();
+
+  // Fails if path can't be mapped or is not a log
+  bool open(const std::string &path);
+  void close();
+
+  size_t size() const { return offsets_.size(); }
+  LogRecord record(size_t i) const;
+  // false if the index had to be rebuilt by scanning the records
+  bool indexed() const { return indexed_; }
+
+ private:
+  bool readIndex();
+  void scanRecords();
+
+  const char *base_;
+  size_t file_size_;
+  // end of the last record
+  uint64_t records_end_;
+  bool indexed_;
+  std::vector<uint64_t> offsets_;
+};
+
+#endif /* TELEMETRY_LOG_H */
@@ -0,0 +1,148 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// chunks per thread, enough for stealing to even out uneven tasks
+const size_t kChunksPerThread = 4;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads) : queued_(0), stop_(false) {
+  if (num_threads <= 0) {
+    num_threads = max(1, (int)thread::hardware_concurrency() - 1);
+  }
+  for (int i = 0; i <= num_threads; ++i) {
+    queues_.push_back(new Queue());
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.push_back(thread(&ThreadPool::workerLoop, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    delete queues_[i];
+  }
+}
+
+size_t ThreadPool::parallelFor(size_t n, const function<void(size_t)> &fn,
+                               Clock::time_point deadline, bool *done) {
+  if (n == 0) {
+    return 0;
+  }
+  if (done != NULL) {
+    fill(done, done + n, false);
+  }
+
+  Job job;
+  job.fn = &fn;
+  job.deadline = deadline;
+  job.done = done;
+  job.completed = 0;
+
+  // deal the chunks round robin over the worker queues
+  size_t num_queues = queues_.size();
+  size_t num_chunks = min(n, num_queues * kChunksPerThread);
+  size_t chunk = (n + num_chunks - 1) / num_chunks;
+  num_chunks = (n + chunk - 1) / chunk;
+  job.pending = num_chunks;
+  // counted before they are published, so a worker taking one right away
+  // can't bring queued_ below zero
+  {
+    lock_guard<mutex> lock(sleep_mutex_);
+    queued_ += num_chunks;
+  }
+  for (size_t c = 0; c < num_chunks; ++c) {
+    Task task = {&job, c * chunk, min(n, (c + 1) * chunk)};
+    Queue &queue = *queues_[c % num_queues];
+    lock_guard<mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  wake_.notify_all();
+
+  // help out until our job is through, then wait for the stragglers
+  int caller = (int)num_queues - 1;
+  Task task;
+  while (job.pending > 0 && popTask(caller, task)) {
+    runTask(task);
+  }
+  unique_lock<mutex> lock(job.mutex);
+  job.finished.wait(lock, [&job] { return job.pending == 0; });
+  return job.completed;
+}
+
+void ThreadPool::workerLoop(int index) {
+  Task task;
+  while (true) {
+    if (popTask(index, task)) {
+      runTask(task);
+      continue;
+    }
+    unique_lock<mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+    if (stop_ && queued_ == 0) {
+      return;
+    }
+  }
+}
+
+bool ThreadPool::popTask(int index, Task &task) {
+  // own queue from the back
+  {
+    Queue &queue = *queues_[index];
+    lock_guard<mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+      --queued_;
+      return true;
+    }
+  }
+  // steal from the front of the others
+  int num_queues = (int)queues_.size();
+  for (int k = 1; k < num_queues; ++k) {
+    Queue &queue = *queues_[(index + k) % num_queues];
+    lock_guard<mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+      --queued_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::runTask(const Task &task) {
+  Job &job = *task.job;
+  size_t ran = 0;
+  for (size_t i = task.begin; i < task.end; ++i) {
+    if (Clock::now() > job.deadline) {
+      break;
+    }
+    (*job.fn)(i);
+    if (job.done != NULL) {
+      job.done[i] = true;
+    }
+    ++ran;
+  }
+  job.completed += ran;
+  // the job lives on the stack of parallelFor(), which returns as soon as
+  // it sees pending == 0, so the last touch of the job must be under the lock
+  lock_guard<mutex> lock(job.mutex);
+  if (--job.pending == 0) {
+    job.finished.notify_all();
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads with work stealing.
+//
+// Threads are started once and sleep while there is nothing to do. Every
+// worker has its own task deque: it pops from the back of its own deque
+// and, when that is empty, steals from the front of the others. The thread
+// calling parallelFor() works on the tasks too while it waits.
+class ThreadPool {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  // 0 threads means one per hardware thread (minus the caller)
+  explicit ThreadPool(int num_threads = 0);
+  ~ThreadPool();
+
+  int size() const { return (int)workers_.size(); }
+
+  // Runs fn(i) for every i in [0, n) spread over the pool and returns once
+  // they are all done. Indices not yet started when the deadline passes
+  // are skipped; done[i] (if given) tells which ones ran. Returns the number
+  // of indices that ran.
+  size_t parallelFor(size_t n, const std::function<void(size_t)> &fn,
+                     Clock::time_point deadline, bool *done = NULL);
+
+ private:
+  struct Job {
+    const std::function<void(size_t)> *fn;
+    Clock::time_point deadline;
+    bool *done;
+    std::atomic<size_t> pending;   // chunks not finished yet
+    std::atomic<size_t> completed; // indices that ran
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+  struct Task {
+    Job *job;
+    size_t begin;
+    size_t end;
+  };
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void workerLoop(int index);
+  bool popTask(int index, Task &task);
+  void runTask(const Task &task);
+
+  std::vector<std::thread> workers_;
+  // one queue per worker plus one for the calling threads
+  std::vector<Queue *> queues_;
+  std::atomic<size_t> queued_;
+  std::atomic<bool> stop_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+};
+
+#endif /* THREAD_POOL_H */
@@ -0,0 +1,121 @@
+#include "traffic.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+using namespace std;
+
+void TrafficSnapshot::build(const Telemetry &t) {
+  const int n = t.num_vehicles;
+  size = n;
+  for (int i = 0; i < n; ++i) {
+    const double *row = t.sensor_fusion[i];
+    id[i] = (int)row[0];
+    x[i] = row[1];
+    y[i] = row[2];
+    vx[i] = row[3];
+    vy[i] = row[4];
+    s[i] = row[5];
+    d[i] = row[6];
+  }
+
+  // derived columns in branch free passes so they vectorize
+  for (int i = 0; i < n; ++i) {
+    speed[i] = sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+  }
+  for (int i = 0; i < n; ++i) {
+    double l = d[i] * (1.0 / kLaneWidth);
+    // off road (and NaN) goes to -1 before the conversion, which is only
+    // defined in range, with a select instead of a branch
+    int on_road = (l >= 0.0) & (l < kNumLanes);
+    lane[i] = (int)(on_road ? l : -1.0);
+  }
+}
+
+LaneIndex::LaneIndex() : max_s_(0.0) {
+  for (int l = 0; l < kNumLanes; ++l) {
+    count_[l] = 0;
+  }
+}
+
+void LaneIndex::build(const TrafficSnapshot &traffic, double max_s) {
+  max_s_ = max_s;
+  for (int l = 0; l < kNumLanes; ++l) {
+    count_[l] = 0;
+  }
+  pair<double, int> sorted[kNumLanes][kMaxVehicles];
+  for (int i = 0; i < traffic.size; ++i) {
+    int l = traffic.lane[i];
+    if (l >= 0) {
+      sorted[l][count_[l]++] = make_pair(wrap(traffic.s[i]), i);
+    }
+  }
+  for (int l = 0; l < kNumLanes; ++l) {
+    sort(sorted[l], sorted[l] + count_[l]);
+    for (int j = 0; j < count_[l]; ++j) {
+      s_[l][j] = sorted[l][j].first;
+      order_[l][j] = sorted[l][j].second;
+    }
+  }
+}
+
+double LaneIndex::wrap(double s) const {
+  s = fmod(s, max_s_);
+  return s < 0.0 ? s + max_s_ : s;
+}
+
+double LaneIndex::delta(double from, double to) const {
+  double ds = wrap(to - from);
+  return ds >= 0.5 * max_s_ ? ds - max_s_ : ds;
+}
+
+int LaneIndex::upperBound(int lane, double value) const {
+  return upper_bound(s_[lane], s_[lane] + count_[lane], value) - s_[lane];
+}
+
+int LaneIndex::lowerBound(int lane, double value) const {
+  return lower_bound(s_[lane], s_[lane] + count_[lane], value) - s_[lane];
+}
+
+int LaneIndex::leader(int lane, double s) const {
+  int n = count_[lane];
+  if (n == 0) {
+    return -1;
+  }
+  int pos = upperBound(lane, wrap(s));
+  return order_[lane][pos == n ? 0 : pos];
+}
+
+int LaneIndex::follower(int lane, double s) const {
+  int n = count_[lane];
+  if (n == 0) {
+    return -1;
+  }
+  int pos = lowerBound(lane, wrap(s)) - 1;
+  return order_[lane][pos < 0 ? n - 1 : pos];
+}
+
+int LaneIndex::inRange(int lane, double s0, double s1, int *out) const {
+  int n = count_[lane];
+  if (n == 0 || s1 < s0) {
+    return 0;
+  }
+  double length = s1 - s0;
+  double begin = wrap(s0);
+  double end = begin + length;
+  int found = 0;
+  int pos = lowerBound(lane, begin);
+  int last = upperBound(lane, min(end, max_s_));
+  while (pos < last) {
+    out[found++] = order_[lane][pos++];
+  }
+  if (end >= max_s_) {
+    // continue from the start of the loop
+    last = upperBound(lane, end - max_s_);
+    for (pos = 0; pos < last; ++pos) {
+      out[found++] = order_[lane][pos];
+    }
+  }
+  return found;
+}
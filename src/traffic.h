@@ -0,0 +1,61 @@
+#ifndef TRAFFIC_H
+#define TRAFFIC_H
+
+#include "telemetry.h"
+
+const int kNumLanes = 3;
+const double kLaneWidth = 4.0;
+
+// Other vehicles of one frame as struct of arrays, unpacked once from the
+// sensor fusion rows so the planner reads plain typed columns.
+struct TrafficSnapshot {
+  int size;
+  int id[kMaxVehicles];
+  double x[kMaxVehicles];
+  double y[kMaxVehicles];
+  double vx[kMaxVehicles];
+  double vy[kMaxVehicles];
+  double speed[kMaxVehicles];
+  double s[kMaxVehicles];
+  double d[kMaxVehicles];
+  // lane index from d, -1 when off our side of the road
+  int lane[kMaxVehicles];
+
+  void build(const Telemetry &t);
+};
+
+// Vehicles of each lane sorted by s, for leader/follower and range queries
+// by binary search. The road is a loop, so every query wraps around at
+// max_s: the leader of the last car in a lane is the first one.
+class LaneIndex {
+ public:
+  LaneIndex();
+
+  void build(const TrafficSnapshot &traffic, double max_s);
+
+  // Nearest vehicle strictly ahead of / behind s in lane, as an index into
+  // the snapshot, or -1 if the lane is empty.
+  int leader(int lane, double s) const;
+  int follower(int lane, double s) const;
+
+  // Writes the vehicles in lane with s in [s0, s1] to out in order of s
+  // from s0 and returns how many. s0 and s1 need not be wrapped, the range
+  // may cross max_s but must be shorter than the loop.
+  int inRange(int lane, double s0, double s1, int *out) const;
+
+  // to - from wrapped into [-max_s/2, max_s/2)
+  double delta(double from, double to) const;
+
+ private:
+  double wrap(double s) const;
+  // first position in lane with s > value / s >= value
+  int upperBound(int lane, double value) const;
+  int lowerBound(int lane, double value) const;
+
+  double max_s_;
+  int count_[kNumLanes];
+  int order_[kNumLanes][kMaxVehicles];
+  double s_[kNumLanes][kMaxVehicles];
+};
+
+#endif /* TRAFFIC_H */
@@ -0,0 +1,143 @@
+#include "vehicle_tracker.h"
+
+namespace {
+
+unsigned hashId(int id) {
+  return (unsigned)id * 2654435761u;
+}
+
+}  // namespace
+
+double VehicleTracker::Track::accelerationS() const {
+  if (count < 3) {
+    return 0.0;
+  }
+  double t0 = latest().t;
+  double sum_t = 0.0, sum_v = 0.0, sum_tt = 0.0, sum_tv = 0.0;
+  for (int age = 0; age < count; ++age) {
+    const TrackSample &p = sample(age);
+    double t = p.t - t0;
+    sum_t += t;
+    sum_v += p.vs;
+    sum_tt += t * t;
+    sum_tv += t * p.vs;
+  }
+  double denom = count * sum_tt - sum_t * sum_t;
+  if (denom <= 1e-12) {
+    return 0.0;
+  }
+  return (count * sum_tv - sum_t * sum_v) / denom;
+}
+
+double VehicleTracker::Track::lateralSpeed(int samples) const {
+  int n = samples < count ? samples : count;
+  if (n == 0) {
+    return 0.0;
+  }
+  double sum = 0.0;
+  for (int age = 0; age < n; ++age) {
+    sum += sample(age).vd;
+  }
+  return sum / n;
+}
+
+VehicleTracker::VehicleTracker() : frame_(0), num_free_(kMaxVehicles) {
+  for (int i = 0; i < kMaxVehicles; ++i) {
+    used_[i] = false;
+    // hand out low slots first
+    free_[i] = kMaxVehicles - 1 - i;
+    slot_of_[i] = -1;
+  }
+  for (int i = 0; i < kTableSize; ++i) {
+    table_id_[i] = -1;
+  }
+}
+
+int VehicleTracker::lookup(int id) const {
+  unsigned pos = hashId(id) % kTableSize;
+  while (table_id_[pos] != -1) {
+    if (table_id_[pos] == id) {
+      return table_slot_[pos];
+    }
+    pos = (pos + 1) % kTableSize;
+  }
+  return -1;
+}
+
+void VehicleTracker::insert(int id, int slot) {
+  unsigned pos = hashId(id) % kTableSize;
+  while (table_id_[pos] != -1) {
+    pos = (pos + 1) % kTableSize;
+  }
+  table_id_[pos] = id;
+  table_slot_[pos] = slot;
+}
+
+void VehicleTracker::rebuildTable() {
+  for (int i = 0; i < kTableSize; ++i) {
+    table_id_[i] = -1;
+  }
+  for (int slot = 0; slot < kMaxVehicles; ++slot) {
+    if (used_[slot]) {
+      insert(tracks_[slot].id, slot);
+    }
+  }
+}
+
+const VehicleTracker::Track *VehicleTracker::find(int id) const {
+  int slot = lookup(id);
+  return slot < 0 ? NULL : &tracks_[slot];
+}
+
+void VehicleTracker::update(const TrafficSnapshot &traffic,
+                            const RoadMap &road_map, double time) {
+  ++frame_;
+  bool dropped = false;
+  for (int slot = 0; slot < kMaxVehicles; ++slot) {
+    if (used_[slot] && frame_ - tracks_[slot].last_frame > kMaxMissedFrames) {
+      used_[slot] = false;
+      free_[num_free_++] = slot;
+      dropped = true;
+    }
+  }
+  if (dropped) {
+    rebuildTable();
+  }
+
+  for (int i = 0; i < traffic.size; ++i) {
+    int id = traffic.id[i];
+    int slot = id < 0 ? -1 : lookup(id);
+    if (slot < 0) {
+      // new vehicle, the pool holds as many tracks as a snapshot has
+      // vehicles once stale ones are dropped
+      if (num_free_ == 0 || id < 0) {
+        slot_of_[i] = -1;
+        continue;
+      }
+      slot = free_[--num_free_];
+      used_[slot] = true;
+      Track &track = tracks_[slot];
+      track.id = id;
+      track.head = 0;
+      track.count = 0;
+      insert(id, slot);
+    }
+    Track &track = tracks_[slot];
+    if (track.count && track.last_frame == frame_) {
+      // duplicate id within one snapshot, keep the first
+      slot_of_[i] = slot;
+      continue;
+    }
+    TrackSample &p = track.history[track.head];
+    p.t = time;
+    p.s = traffic.s[i];
+    p.d = traffic.d[i];
+    road_map.getFrenetVelocity(p.s, traffic.vx[i], traffic.vy[i], p.vs, p.vd);
+    track.head = (track.head + 1) % kHistoryLength;
+    if (track.count < kHistoryLength) {
+      ++track.count;
+    }
+    track.last_frame = frame_;
+    slot_of_[i] = slot;
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef VEHICLE_TRACKER_H
+#define VEHICLE_TRACKER_H
+
+#include <stddef.h>
+
+#include "road_map.h"
+#include "traffic.h"
+
+// Samples of history kept per vehicle
+const int kHistoryLength = 16;
+// Tracks not updated for this many frames are dropped
+const int kMaxMissedFrames = 25;
+
+// Frenet state of a vehicle at time t
+struct TrackSample {
+  double t;
+  double s;
+  double d;
+  double vs;
+  double vd;
+};
+
+// Keeps recent Frenet states of every vehicle across frames, keyed by the
+// sensor fusion id.
+//
+// Tracks live in a fixed pool with a ring buffer of kHistoryLength samples
+// each, so an update writes one sample per vehicle and memory never grows.
+// Ids are mapped to pool slots through an open addressing table that is
+// rebuilt only when tracks are dropped.
+class VehicleTracker {
+ public:
+  struct Track {
+    int id;
+    int last_frame;  // frame of the latest sample
+    int head;        // where the next sample goes
+    int count;       // valid samples, up to kHistoryLength
+    TrackSample history[kHistoryLength];
+
+    // age 0 is the latest sample, age count-1 the oldest
+    const TrackSample &sample(int age) const {
+      return history[(head - 1 - age + kHistoryLength) % kHistoryLength];
+    }
+    const TrackSample &latest() const { return sample(0); }
+
+    // least squares slope of vs over the history, 0 with < 3 samples
+    double accelerationS() const;
+    // mean vd of the latest samples, positive when drifting to the right
+    double lateralSpeed(int samples) const;
+  };
+
+  VehicleTracker();
+
+  // Drops tracks that went missing and adds one sample for every vehicle
+  // of the snapshot taken at time (seconds).
+  void update(const TrafficSnapshot &traffic, const RoadMap &road_map,
+              double time);
+
+  // Track of a sensor fusion id, NULL if unknown
+  const Track *find(int id) const;
+  // Track of vehicle i of the last snapshot passed to update(), NULL if
+  // it could not be tracked
+  const Track *track(int i) const {
+    return slot_of_[i] < 0 ? NULL : &tracks_[slot_of_[i]];
+  }
+
+  int size() const { return kMaxVehicles - num_free_; }
+
+ private:
+  static const int kTableSize = 2 * kMaxVehicles;
+
+  int lookup(int id) const;
+  void insert(int id, int slot);
+  void rebuildTable();
+
+  int frame_;
+  Track tracks_[kMaxVehicles];
+  bool used_[kMaxVehicles];
+  int free_[kMaxVehicles];
+  int num_free_;
+  // id -> slot, -1 marks an empty entry
+  int table_id_[kTableSize];
+  int table_slot_[kTableSize];
+  // slot of each vehicle of the last snapshot
+  int slot_of_[kMaxVehicles];
+};
+
+#endif /* VEHICLE_TRACKER_H */
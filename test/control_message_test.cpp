@@ -0,0 +1,212 @@
+// Checks formatDouble: every finite double has to read back to the same
+// bits with strtod, in no more significant digits than the shortest
+// decimal that does, and ControlMessage has to carry the values of the
+// path unchanged. Exits with 1 on any failure.
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "control_message.h"
+
+using namespace std;
+
+namespace {
+
+const int kRandomValues = 200000;
+
+int failures = 0;
+
+void fail(double v, const string &text, const char *what) {
+  ++failures;
+  if (failures <= 20) {
+    char exact[64];
+    snprintf(exact, sizeof(exact), "%.17g", v);
+    cerr << exact << " written as " << text << ": " << what << endl;
+  }
+}
+
+// digits of the decimal significand, without sign, point, exponent and
+// leading or trailing zeros
+int significantDigits(const string &text) {
+  size_t end = text.find_first_of("eE");
+  if (end == string::npos) {
+    end = text.size();
+  }
+  string digits;
+  for (size_t i = 0; i < end; ++i) {
+    if (text[i] >= '0' && text[i] <= '9') {
+      digits += text[i];
+    }
+  }
+  size_t first = digits.find_first_not_of('0');
+  if (first == string::npos) {
+    return 1;
+  }
+  size_t last = digits.find_last_not_of('0');
+  return (int)(last - first + 1);
+}
+
+// fewest significant digits that read back as v
+int shortestDigits(double v) {
+  char buffer[64];
+  for (int p = 1; p < 17; ++p) {
+    snprintf(buffer, sizeof(buffer), "%.*e", p - 1, v);
+    if (strtod(buffer, NULL) == v) {
+      return p;
+    }
+  }
+  return 17;
+}
+
+bool sameBits(double a, double b) {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+void check(double v) {
+  char out[kMaxDoubleChars + 1];
+  int n = formatDouble(v, out);
+  if (n <= 0 || n > kMaxDoubleChars) {
+    fail(v, "", "length out of range");
+    return;
+  }
+  out[n] = '\0';
+  string text(out, n);
+  if (!isfinite(v)) {
+    if (text != "null") {
+      fail(v, text, "expected null");
+    }
+    return;
+  }
+  char *end;
+  double back = strtod(out, &end);
+  if (end != out + n) {
+    fail(v, text, "not a number");
+  } else if (v == 0.0) {
+    // JSON readers drop the sign of zero anyway, it is written as 0
+    if (text != "0") {
+      fail(v, text, "expected 0");
+    }
+  } else if (!sameBits(back, v)) {
+    fail(v, text, "reads back as another value");
+  } else if (significantDigits(text) > shortestDigits(v)) {
+    fail(v, text, "not the shortest");
+  }
+}
+
+void checkEdgeCases() {
+  const double values[] = {
+    0.0, -0.0, 1.0, -1.0, 0.1, 0.2, 0.3, 1.0 / 3.0, 2.0 / 3.0, 100.0,
+    123456.0, 909.48, 1128.67, 6945.554, 1e-5, 1e-6, 1e15, 1e16, 1e21,
+    1e22, 1e23, 9007199254740991.0, 9007199254740992.0,
+    9007199254740993.0, DBL_MAX, -DBL_MAX, DBL_MIN, DBL_MIN / 2.0,
+    5e-324, DBL_EPSILON, M_PI, M_E, 0.30000000000000004,
+    HUGE_VAL, -HUGE_VAL, NAN,
+  };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+    check(values[i]);
+  }
+  // both sides of every power of ten and of the ends of the integer path
+  for (int e = -330; e <= 310; ++e) {
+    double p = strtod(("1e" + to_string(e)).c_str(), NULL);
+    for (int k = 0; k < 4; ++k) {
+      check(p);
+      check(-p);
+      check(nextafter(p, 0.0));
+      check(nextafter(p, HUGE_VAL));
+      p = nextafter(p, HUGE_VAL);
+    }
+  }
+}
+
+void checkRandomValues() {
+  mt19937_64 rng(1);
+  uniform_real_distribution<double> uniform(-7000.0, 7000.0);
+  uniform_int_distribution<int> exponent(-20, 20);
+  for (int i = 0; i < kRandomValues; ++i) {
+    double v;
+    switch (i % 4) {
+      case 0:
+        // map coordinates as they are sent
+        v = uniform(rng);
+        break;
+      case 1:
+        // few significant digits, the shortest output is short
+        v = strtod(to_string((long long)(uniform(rng) * 1000.0)).c_str(),
+                   NULL) * pow(10.0, exponent(rng));
+        break;
+      case 2:
+        v = uniform(rng) * pow(10.0, exponent(rng));
+        break;
+      default: {
+        // raw bit patterns, any magnitude
+        uint64_t bits = rng();
+        memcpy(&v, &bits, sizeof(v));
+        break;
+      }
+    }
+    check(v);
+  }
+}
+
+void checkControlMessage() {
+  mt19937_64 rng(2);
+  uniform_real_distribution<double> uniform(-7000.0, 7000.0);
+  vector<double> x(50), y(50);
+  for (size_t i = 0; i < x.size(); ++i) {
+    x[i] = uniform(rng);
+    y[i] = uniform(rng);
+  }
+  ControlMessage message;
+  message.build(&x[0], &y[0], (int)x.size());
+  string text(message.data(), message.length());
+  const string prefix = "42[\"control\",{\"next_x\":[";
+  if (text.compare(0, prefix.size(), prefix) != 0) {
+    ++failures;
+    cerr << "control message starts with " << text.substr(0, 40) << endl;
+    return;
+  }
+  const char *p = text.c_str() + prefix.size();
+  for (int k = 0; k < 2; ++k) {
+    const vector<double> &values = k ? y : x;
+    for (size_t i = 0; i < values.size(); ++i) {
+      char *end;
+      double v = strtod(p, &end);
+      if (end == p || !sameBits(v, values[i])) {
+        ++failures;
+        cerr << "control message value " << i << " differs" << endl;
+        return;
+      }
+      p = end + 1;
+    }
+    if (k == 0) {
+      p = strstr(p, "[") + 1;
+    }
+  }
+  if (strcmp(p - 1, "]}]") != 0) {
+    ++failures;
+    cerr << "control message ends with " << p - 1 << endl;
+  }
+}
+
+}  // namespace
+
+int main() {
+  checkEdgeCases();
+  checkRandomValues();
+  checkControlMessage();
+  if (failures > 0) {
+    cerr << failures << " failures" << endl;
+    return 1;
+  }
+  cout << "formatDouble writes the shortest round trip" << endl;
+  return 0;
+}
@@ -0,0 +1,309 @@
+// Checks parseTelemetry against json::parse, which the server used before:
+// on frames from the headless simulator, on random numbers in every JSON
+// spelling and on edge cases. Both have to reject the same frames and read
+// every value to the same bits. Exits with 1 on any difference.
+//
+// Run from src/ so ../data/highway_map.csv is found.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "control_message.h"
+#include "json.hpp"
+#include "path_planner.h"
+#include "road_map.h"
+#include "simulator.h"
+#include "telemetry.h"
+#include "thread_pool.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+
+const int kSimulatedFrames = 500;
+const int kRandomNumbers = 200000;
+
+int failures = 0;
+
+// reads the frame the way the server did before parseTelemetry, false
+// where that threw
+bool referenceParse(const string &frame, Telemetry &t) {
+  try {
+    json j = json::parse(frame.substr(2));
+    if (j[0] != "telemetry") {
+      return false;
+    }
+    json &data = j[1];
+    t.x = data["x"];
+    t.y = data["y"];
+    t.s = data["s"];
+    t.d = data["d"];
+    t.yaw = data["yaw"];
+    t.speed = data["speed"];
+    const json &previous_path_x = data["previous_path_x"];
+    const json &previous_path_y = data["previous_path_y"];
+    if (!previous_path_x.is_array() || !previous_path_y.is_array() ||
+        previous_path_x.size() != previous_path_y.size()) {
+      return false;
+    }
+    t.prev_size = previous_path_x.size();
+    for (int i = 0; i < t.prev_size; ++i) {
+      t.previous_path_x[i] = previous_path_x[i];
+      t.previous_path_y[i] = previous_path_y[i];
+    }
+    t.end_path_s = data["end_path_s"];
+    t.end_path_d = data["end_path_d"];
+    const json &sensor_fusion = data["sensor_fusion"];
+    if (!sensor_fusion.is_array()) {
+      return false;
+    }
+    t.num_vehicles = sensor_fusion.size();
+    for (int i = 0; i < t.num_vehicles; ++i) {
+      if (sensor_fusion[i].size() != 7) {
+        return false;
+      }
+      for (int k = 0; k < 7; ++k) {
+        t.sensor_fusion[i][k] = sensor_fusion[i][k];
+      }
+    }
+    return true;
+  } catch (const exception &) {
+    return false;
+  }
+}
+
+bool sameBits(double a, double b) {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+bool sameTelemetry(const Telemetry &a, const Telemetry &b) {
+  if (!sameBits(a.x, b.x) || !sameBits(a.y, b.y) || !sameBits(a.s, b.s) ||
+      !sameBits(a.d, b.d) || !sameBits(a.yaw, b.yaw) ||
+      !sameBits(a.speed, b.speed) || !sameBits(a.end_path_s, b.end_path_s) ||
+      !sameBits(a.end_path_d, b.end_path_d) || a.prev_size != b.prev_size ||
+      a.num_vehicles != b.num_vehicles) {
+    return false;
+  }
+  for (int i = 0; i < a.prev_size; ++i) {
+    if (!sameBits(a.previous_path_x[i], b.previous_path_x[i]) ||
+        !sameBits(a.previous_path_y[i], b.previous_path_y[i])) {
+      return false;
+    }
+  }
+  for (int i = 0; i < a.num_vehicles; ++i) {
+    for (int k = 0; k < 7; ++k) {
+      if (!sameBits(a.sensor_fusion[i][k], b.sensor_fusion[i][k])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void check(const string &frame) {
+  unique_ptr<Telemetry> parsed(new Telemetry);
+  unique_ptr<Telemetry> expected(new Telemetry);
+  bool ok = parseTelemetry(frame.data(), frame.size(), *parsed) ==
+            kTelemetryOk;
+  bool expected_ok = referenceParse(frame, *expected);
+  if (ok != expected_ok || (ok && !sameTelemetry(*parsed, *expected))) {
+    ++failures;
+    if (failures <= 20) {
+      cerr << (ok ? "parsed" : "rejected") << ", json::parse "
+           << (expected_ok ? "parsed" : "rejected")
+           << (ok == expected_ok ? " to other values" : "") << ": "
+           << frame.substr(0, 200) << endl;
+    }
+  }
+}
+
+// a frame with every field, values given as raw JSON text
+typedef map<string, string> Fields;
+
+Fields defaultFields() {
+  Fields fields;
+  fields["x"] = "909.48";
+  fields["y"] = "1128.67";
+  fields["s"] = "124.834";
+  fields["d"] = "6.16483";
+  fields["yaw"] = "0";
+  fields["speed"] = "0";
+  fields["previous_path_x"] = "[909.5,909.7]";
+  fields["previous_path_y"] = "[1128.7,1128.7]";
+  fields["end_path_s"] = "125.1";
+  fields["end_path_d"] = "6.0";
+  fields["sensor_fusion"] =
+      "[[0,1,2,3,4,5,6],[1,775.8,1421.6,0,0,6721.8,-277.6]]";
+  return fields;
+}
+
+string frameOf(const Fields &fields) {
+  string frame = "42[\"telemetry\",{";
+  for (Fields::const_iterator it = fields.begin(); it != fields.end(); ++it) {
+    if (it != fields.begin()) {
+      frame += ',';
+    }
+    frame += "\"" + it->first + "\":" + it->second;
+  }
+  return frame + "}]";
+}
+
+// every field set to the same number
+void checkNumber(const string &number) {
+  Fields fields = defaultFields();
+  const char *scalars[] = {"x", "y", "s", "d", "yaw", "speed",
+                           "end_path_s", "end_path_d"};
+  for (size_t i = 0; i < sizeof(scalars) / sizeof(scalars[0]); ++i) {
+    fields[scalars[i]] = number;
+  }
+  fields["previous_path_x"] = "[" + number + "," + number + "]";
+  fields["previous_path_y"] = "[1," + number + "]";
+  fields["sensor_fusion"] = "[[" + number + ",1,2,3,4,5," + number + "]]";
+  check(frameOf(fields));
+}
+
+void checkSimulatedFrames() {
+  RoadMap road_map;
+  if (!road_map.load("../data/highway_map.csv", 6945.554)) {
+    cerr << "Failed to load map ../data/highway_map.csv" << endl;
+    ++failures;
+    return;
+  }
+  road_map.resample(0.5);
+  Simulator sim(road_map, SimulatorConfig());
+  ThreadPool pool;
+  PathPlanner planner(road_map, pool);
+  unique_ptr<Telemetry> telemetry(new Telemetry);
+  ControlMessage control;
+  string message;
+  for (int i = 0; i < kSimulatedFrames; ++i) {
+    sim.telemetry(message);
+    check(message);
+    if (parseTelemetry(message.data(), message.size(), *telemetry) !=
+        kTelemetryOk) {
+      return;
+    }
+    planner.plan(*telemetry, sim.stats().time, control);
+    sim.control(control.data(), control.length());
+  }
+}
+
+void checkRandomNumbers() {
+  mt19937_64 rng(1);
+  uniform_real_distribution<double> uniform(-7000.0, 7000.0);
+  uniform_int_distribution<int> exponent(-330, 310);
+  const char *formats[] = {"%.17g", "%.15g", "%.6f", "%.3e", "%.20E",
+                           "%.1f", "%g", "%.25f"};
+  const int num_formats = sizeof(formats) / sizeof(formats[0]);
+  char buffer[512];
+  for (int i = 0; i < kRandomNumbers; ++i) {
+    double value = uniform(rng);
+    switch (i % 4) {
+      case 1:
+        // any magnitude, out of range ones included
+        value *= pow(10.0, exponent(rng));
+        break;
+      case 2:
+        // integers, beyond 2^53 and 2^64 as well
+        value = floor(value * pow(10.0, exponent(rng) % 20));
+        break;
+      case 3: {
+        // raw bit patterns
+        uint64_t bits = rng();
+        memcpy(&value, &bits, sizeof(value));
+        if (!isfinite(value)) {
+          continue;
+        }
+        break;
+      }
+    }
+    snprintf(buffer, sizeof(buffer), formats[i % num_formats], value);
+    checkNumber(buffer);
+  }
+}
+
+void checkEdgeCases() {
+  const char *numbers[] = {
+    // zeros and signs
+    "0", "-0", "0.0", "-0.0", "0e0", "-0e0", "-0E-5", "0.000",
+    // exponents
+    "1e5", "1E5", "1e+5", "1e-5", "12.5e3", "-2.5E-3", "1e22", "1e23",
+    "1e-22", "1e-23", "1e308", "1.7976931348623157e308", "1e309",
+    "-1e309", "4.9e-324", "2.4e-324", "1e-400", "123e-2", "0.5e1",
+    // digits beyond what a double holds
+    "9007199254740992", "9007199254740993", "9007199254740995",
+    "18446744073709551615", "18446744073709551616",
+    "-9223372036854775808", "-9223372036854775809",
+    "1234567890123456789012345678901234567890",
+    "0.1234567890123456789012345678901234567890",
+    "3.14159265358979323846264338327950288419716939937510582097494459"
+    "2307816406286208998628034825342117067982148086513282306647093844",
+    // not JSON numbers
+    "01", "-01", "00", ".5", "-.5", "1.", "1.e5", "+1", "-", "1e", "1e+",
+    "0x10", "NaN", "Infinity", "1,5", "\"1\"", "null", "true",
+  };
+  for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); ++i) {
+    checkNumber(numbers[i]);
+  }
+
+  // empty arrays
+  Fields fields = defaultFields();
+  fields["previous_path_x"] = "[]";
+  fields["previous_path_y"] = "[ ]";
+  fields["sensor_fusion"] = "[]";
+  check(frameOf(fields));
+
+  // previous path of different lengths
+  fields = defaultFields();
+  fields["previous_path_y"] = "[1]";
+  check(frameOf(fields));
+
+  // missing keys, each one and all of them
+  Fields full = defaultFields();
+  for (Fields::const_iterator it = full.begin(); it != full.end(); ++it) {
+    fields = full;
+    fields.erase(it->first);
+    check(frameOf(fields));
+  }
+  check("42[\"telemetry\",{}]");
+
+  // unknown keys, whitespace, duplicates
+  fields = defaultFields();
+  fields["extra"] = "{\"a\":[1,2,{\"b\":null}],\"c\":\"x\\\"y\"}";
+  check(frameOf(fields));
+  // the frame without its 42["telemetry",{ prefix
+  string rest = frameOf(defaultFields()).substr(16);
+  check("42[ \"telemetry\" ,\n{ \"unused\" : [ ] , " + rest);
+  check("42[\"telemetry\",{\"x\":1," + rest);
+
+  // broken frames
+  string frame = frameOf(defaultFields());
+  for (size_t cut = 3; cut < frame.size(); cut += 7) {
+    check(frame.substr(0, cut));
+  }
+}
+
+}  // namespace
+
+int main() {
+  checkEdgeCases();
+  checkRandomNumbers();
+  checkSimulatedFrames();
+  if (failures > 0) {
+    cerr << failures << " frames parsed differently from json::parse"
+         << endl;
+    return 1;
+  }
+  cout << "parseTelemetry matches json::parse" << endl;
+  return 0;
+}